@@ -0,0 +1,548 @@
+// Headless benchmark for HmlPhysics. Links only HmlPhysics.cpp and HmlMath.cpp.
+//
+// Runs scripted scenes (ported from the Himmel::testbench* functions plus
+// large random clouds) for every requested object count, Mode, Broadphase and
+// helper thread count, and prints a row per run as CSV or JSON.
+//
+// Usage:
+//   HmlPhysicsBench [--scenes boxWithObjects,impulse,friction,sphereCloud,boxCloud]
+//                   [--counts 1000,4000,16000] [--modes 0,1,2,3] [--broadphases 0,1,2]
+//                   [--threads 1,2,4,8] [--frames 300] [--format csv|json]
+//   HmlPhysicsBench --micro gjk [--pairs 100000]
+//
+// Modes and Broadphases are given by their index in the corresponding enum.
+// In Modes with a self thread the frames are paced in real time (as the app
+// would do) and the phase timings are sampled from the last step of the frame.
+//
+// --micro runs a single narrowphase query over random overlapping pairs
+// instead, and reports nanoseconds and heap allocations per pair.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "HmlPhysics.h"
+
+
+// Counts every heap allocation in the process, for the --micro queries
+static std::atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+
+// ============================================================================
+// ======================== Scenes ============================================
+// ============================================================================
+namespace {
+
+float randomUniformFloat(float low, float high) noexcept {
+    static std::mt19937 e2(300);
+    std::uniform_real_distribution<float> dist(low, high);
+    return dist(e2);
+}
+
+
+glm::quat randomOrientation() noexcept {
+    const auto axis = glm::vec3{
+        randomUniformFloat(-1.0f, 1.0f),
+        randomUniformFloat(-1.0f, 1.0f),
+        randomUniformFloat(-1.0f, 1.0f)
+    } + glm::vec3{ 0.0f, 1e-3f, 0.0f };
+    return glm::rotate(glm::quat(1, glm::vec3{}), randomUniformFloat(0.0f, glm::pi<float>()), glm::normalize(axis));
+}
+
+
+struct Scene {
+    const char* name;
+    bool withGravity;
+    // Registers about count Objects
+    std::function<void(HmlPhysics&, size_t count)> build;
+};
+
+
+// The closed box with a tilted platform and boxes and spheres thrown in from
+// above. The box grows with count so that the density stays about the same as
+// in the original 100 Objects scene.
+void buildBoxWithObjects(HmlPhysics& physics, size_t count) noexcept {
+    const float scale = std::cbrt(std::max(count, size_t{ 100 }) / 100.0f);
+    const float halfSide = 50.0f * scale;
+    const float baseHeight = 50.0f;
+    const float halfHeight = halfSide;
+    const float wallThickness = 2.0f;
+
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight, 0 }, { halfSide, wallThickness, halfSide }));
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight + 2 * halfHeight, 0 }, { halfSide, wallThickness, halfSide }));
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight + halfHeight, -halfSide }, { halfSide, halfHeight, wallThickness }));
+    physics.registerObject(HmlPhysics::Object::createBox({ -halfSide, baseHeight + halfHeight, 0 }, { wallThickness, halfHeight, halfSide }));
+    physics.registerObject(HmlPhysics::Object::createBox({ +halfSide, baseHeight + halfHeight, 0 }, { wallThickness, halfHeight, halfSide }));
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight + halfHeight, +halfSide }, { halfSide, halfHeight, wallThickness }));
+    { // Platform
+        auto object = HmlPhysics::Object::createBox({ 0, baseHeight + 0.8f*halfHeight, 0 },
+                { 0.35f*halfSide, 0.6f*wallThickness, 0.35f*halfSide });
+        object.orientation = glm::rotate(glm::quat(1, glm::vec3{}), 2 * 0.2f, glm::vec3(0,0,1));
+        physics.registerObject(std::move(object));
+    }
+
+    const float density = 4.0f;
+    const float maxSpeed = 6.0f;
+    const size_t boxesCount = count * 4 / 10;
+    const size_t spheresCount = count - boxesCount;
+    const auto randomPos = [&]{
+        return glm::vec3{
+            randomUniformFloat(-halfSide*0.8f, halfSide*0.8f),
+            randomUniformFloat(baseHeight + 0.2f * halfHeight, baseHeight + 1.8f * halfHeight),
+            randomUniformFloat(-halfSide*0.8f, halfSide*0.8f)
+        };
+    };
+    const auto randomVelocity = [&]{
+        return glm::vec3{
+            randomUniformFloat(-maxSpeed, maxSpeed),
+            0.0f,
+            randomUniformFloat(-maxSpeed, maxSpeed)
+        };
+    };
+    for (size_t i = 0; i < boxesCount; i++) {
+        const auto halfDimensions = glm::vec3{
+            randomUniformFloat(0.4f, 2.0f),
+            2.0f,
+            randomUniformFloat(0.4f, 2.0f)
+        };
+        const float volume = 8 * halfDimensions.x * halfDimensions.y * halfDimensions.z;
+        const float mass = volume * density;
+        physics.registerObject(HmlPhysics::Object::createBox(randomPos(), halfDimensions, mass, randomVelocity(), glm::vec3{0,0,0}));
+    }
+    for (size_t i = 0; i < spheresCount; i++) {
+        const float radius = randomUniformFloat(0.4f, 2.0f);
+        const float volume = 4.0f / 3.0f * glm::pi<float>() * radius * radius * radius;
+        const float mass = volume * density;
+        physics.registerObject(HmlPhysics::Object::createSphere(randomPos(), radius, mass, randomVelocity(), glm::vec3{}));
+    }
+}
+
+
+// Cells of the dynamic walls from testbenchImpulse laid out on a common floor:
+// a tilted pillar falling over, a standing pillar and a spinning slab that
+// slides into it.
+void buildImpulse(HmlPhysics& physics, size_t count) noexcept {
+    const size_t cellsCount = std::max(count / 3, size_t{ 1 });
+    const size_t cellsPerSide = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(cellsCount))));
+    const float cellSide = 30.0f;
+    const float baseHeight = 50.0f;
+    const float halfSide = 0.5f * cellSide * cellsPerSide + cellSide;
+
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight, 0 }, { halfSide, 2.0f, halfSide }));
+
+    for (size_t cell = 0; cell < cellsCount; cell++) {
+        const auto offset = glm::vec3{
+            (static_cast<float>(cell % cellsPerSide) - 0.5f * cellsPerSide) * cellSide,
+            0.0f,
+            (static_cast<float>(cell / cellsPerSide) - 0.5f * cellsPerSide) * cellSide
+        };
+        { // Dyn wall 1
+            auto object = HmlPhysics::Object::createBox(
+                offset + glm::vec3{ 5, baseHeight + 10, 0 }, { 0.8f, 4, 0.8f }, 6, glm::vec3{ 0, 0, 0 }, glm::vec3{0,0,0});
+            object.orientation = glm::rotate(glm::quat(1, glm::vec3{}), 2 * 0.5f, glm::vec3(0,0,1));
+            physics.registerObject(std::move(object));
+        }
+        { // Dyn wall 3
+            physics.registerObject(HmlPhysics::Object::createBox(
+                offset + glm::vec3{ -6.5f, baseHeight + 6, -5.7f }, { 1, 4, 1 }, 5, glm::vec3{ 0, 0, 0 }, glm::vec3{0,0,0}));
+        }
+        { // Dyn wall 4
+            physics.registerObject(HmlPhysics::Object::createBox(
+                offset + glm::vec3{ -10, baseHeight + 5, -10 }, { 6, 2, 4 }, 5, glm::vec3{ 0, 0, 8 }, glm::vec3{0,1,0}));
+        }
+    }
+}
+
+
+// Cells of the sliding box from testbenchFriction laid out on a common floor
+void buildFriction(HmlPhysics& physics, size_t count) noexcept {
+    const size_t cellsPerSide = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(std::max(count, size_t{ 1 })))));
+    const float cellSide = 6.0f;
+    const float baseHeight = 50.0f;
+    const float halfSide = 0.5f * cellSide * cellsPerSide + cellSide;
+
+    physics.registerObject(HmlPhysics::Object::createBox({ 0, baseHeight, 0 }, { halfSide, 2.0f, halfSide }));
+
+    for (size_t cell = 0; cell < count; cell++) {
+        const auto offset = glm::vec3{
+            (static_cast<float>(cell % cellsPerSide) - 0.5f * cellsPerSide) * cellSide,
+            0.0f,
+            (static_cast<float>(cell / cellsPerSide) - 0.5f * cellsPerSide) * cellSide
+        };
+        physics.registerObject(HmlPhysics::Object::createBox(
+            offset + glm::vec3{ 0, baseHeight + 5.1f, 0 }, { 1, 3, 1 }, 5, glm::vec3{ 1, 0, 0 }, glm::vec3{0,0,0}));
+    }
+}
+
+
+// Weightless Objects with random velocities scattered in a cube that grows
+// with count, so every Object has a few neighbours at any time.
+void buildCloud(HmlPhysics& physics, size_t count, bool spheres) noexcept {
+    const float halfSide = 0.5f * 5.0f * std::cbrt(static_cast<float>(count));
+    const float density = 4.0f;
+    const float maxSpeed = 6.0f;
+    for (size_t i = 0; i < count; i++) {
+        const auto pos = glm::vec3{
+            randomUniformFloat(-halfSide, halfSide),
+            randomUniformFloat(-halfSide, halfSide),
+            randomUniformFloat(-halfSide, halfSide)
+        };
+        const auto velocity = glm::vec3{
+            randomUniformFloat(-maxSpeed, maxSpeed),
+            randomUniformFloat(-maxSpeed, maxSpeed),
+            randomUniformFloat(-maxSpeed, maxSpeed)
+        };
+        if (spheres) {
+            const float radius = randomUniformFloat(0.4f, 2.0f);
+            const float mass = 4.0f / 3.0f * glm::pi<float>() * radius * radius * radius * density;
+            physics.registerObject(HmlPhysics::Object::createSphere(pos, radius, mass, velocity, glm::vec3{}));
+        } else {
+            const auto halfDimensions = glm::vec3{
+                randomUniformFloat(0.4f, 2.0f),
+                randomUniformFloat(0.4f, 2.0f),
+                randomUniformFloat(0.4f, 2.0f)
+            };
+            const float mass = 8 * halfDimensions.x * halfDimensions.y * halfDimensions.z * density;
+            auto object = HmlPhysics::Object::createBox(pos, halfDimensions, mass, velocity, glm::vec3{});
+            object.orientation = randomOrientation();
+            physics.registerObject(std::move(object));
+        }
+    }
+}
+
+
+const std::vector<Scene>& allScenes() noexcept {
+    static const std::vector<Scene> scenes = {
+        { "boxWithObjects", true,  buildBoxWithObjects },
+        { "impulse",        true,  buildImpulse },
+        { "friction",       true,  buildFriction },
+        { "sphereCloud",    false, [](HmlPhysics& physics, size_t count){ buildCloud(physics, count, true); } },
+        { "boxCloud",       false, [](HmlPhysics& physics, size_t count){ buildCloud(physics, count, false); } },
+    };
+    return scenes;
+}
+// ============================================================================
+// ======================== Running ===========================================
+// ============================================================================
+const char* modeName(HmlPhysics::Mode mode) noexcept {
+    switch (mode) {
+        case HmlPhysics::Mode::SameThread:                    return "SameThread";
+        case HmlPhysics::Mode::SameThreadAndHelperThreads:    return "SameThreadAndHelperThreads";
+        case HmlPhysics::Mode::AnotherThread:                 return "AnotherThread";
+        case HmlPhysics::Mode::AnotherThreadAndHelperThreads: return "AnotherThreadAndHelperThreads";
+        default: return "Unknown";
+    }
+}
+
+
+const char* broadphaseName(HmlPhysics::Broadphase broadphase) noexcept {
+    switch (broadphase) {
+        case HmlPhysics::Broadphase::Grid:          return "Grid";
+        case HmlPhysics::Broadphase::SweepAndPrune: return "SweepAndPrune";
+        case HmlPhysics::Broadphase::AabbTree:      return "AabbTree";
+        default: return "Unknown";
+    }
+}
+
+
+struct Config {
+    std::vector<std::string> scenes;
+    std::vector<size_t> counts       = { 1000, 4000, 16000 };
+    std::vector<size_t> modes        = { 0, 1, 2, 3 };
+    std::vector<size_t> broadphases  = { 0, 1, 2 };
+    std::vector<size_t> threads      = { 1, 2, 4, 8 };
+    size_t frames = 300;
+    bool json = false;
+    std::string micro; // runs the microbenchmark instead of the scenes if set
+    size_t pairs = 100000;
+};
+
+
+struct Result {
+    std::string scene;
+    HmlPhysics::Mode mode;
+    HmlPhysics::Broadphase broadphase;
+    size_t threads;
+    size_t objects;
+    size_t frames;
+    double stepMillis;
+    double integrationMicros;
+    double broadphaseMicros;
+    double narrowphaseMicros;
+    double solverMicros;
+    double candidatePairs;
+    double pairsPerSecond;
+    double speedup; // relative to the first thread count of the same run
+};
+
+
+Result run(const Scene& scene, size_t count, HmlPhysics::Mode mode,
+        HmlPhysics::Broadphase broadphase, size_t threads, size_t frames) noexcept {
+    HmlPhysics physics(mode, broadphase, threads);
+    if (!scene.withGravity) physics.setGravity(glm::vec3{ 0.0f });
+    scene.build(physics, count);
+
+    const float dt = 1.0f / 60.0f;
+    const auto frameDuration = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+        std::chrono::duration<float>(dt));
+    // Let the self thread register everything before we start measuring
+    if (physics.hasSelfThread()) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    double integrationMicros = 0.0;
+    double broadphaseMicros = 0.0;
+    double narrowphaseMicros = 0.0;
+    double solverMicros = 0.0;
+    double candidatePairs = 0.0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    auto frameEnd = start;
+    for (size_t frame = 0; frame < frames; frame++) {
+        physics.updateForDt(dt);
+        if (physics.hasSelfThread()) {
+            frameEnd += frameDuration;
+            std::this_thread::sleep_until(frameEnd);
+        }
+        const auto stats = physics.getStepStats();
+        integrationMicros += stats.integrationMicros;
+        broadphaseMicros  += stats.broadphaseMicros;
+        narrowphaseMicros += stats.narrowphaseMicros;
+        solverMicros      += stats.solverMicros;
+        candidatePairs    += stats.candidatePairs;
+    }
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const size_t objects = physics.getModelMatrices().size();
+    physics.terminate();
+
+    const double n = static_cast<double>(std::max(frames, size_t{ 1 }));
+    const double stepMillis = physics.hasSelfThread()
+        ? (integrationMicros + broadphaseMicros + narrowphaseMicros + solverMicros) / n / 1000.0
+        : std::chrono::duration<double, std::milli>(finish - start).count() / n;
+
+    return Result{
+        .scene = scene.name,
+        .mode = mode,
+        .broadphase = broadphase,
+        .threads = physics.hasHelperThreads() ? threads : 0,
+        .objects = objects,
+        .frames = frames,
+        .stepMillis = stepMillis,
+        .integrationMicros = integrationMicros / n,
+        .broadphaseMicros = broadphaseMicros / n,
+        .narrowphaseMicros = narrowphaseMicros / n,
+        .solverMicros = solverMicros / n,
+        .candidatePairs = candidatePairs / n,
+        .pairsPerSecond = (stepMillis > 0.0) ? candidatePairs / n / (stepMillis / 1000.0) : 0.0,
+        .speedup = 1.0,
+    };
+}
+// ============================================================================
+// ======================== Microbenchmarks ===================================
+// ============================================================================
+struct MicroResult {
+    size_t pairs;
+    size_t hits;
+    double nanosPerPair;
+    double allocationsPerPair;
+};
+
+
+// Random Box pairs with overlapping bounding spheres, so most of them intersect
+MicroResult runGjkMicro(size_t pairCount) noexcept {
+    std::vector<std::pair<HmlPhysics::Object, HmlPhysics::Object>> pairs;
+    pairs.reserve(pairCount);
+    for (size_t i = 0; i < pairCount; i++) {
+        const auto randomHalfDimensions = []{
+            return glm::vec3{ randomUniformFloat(0.5f, 1.5f), randomUniformFloat(0.5f, 1.5f), randomUniformFloat(0.5f, 1.5f) };
+        };
+        auto box1 = HmlPhysics::Object::createBox(glm::vec3{ 0.0f }, randomHalfDimensions());
+        auto box2 = HmlPhysics::Object::createBox(glm::vec3{
+            randomUniformFloat(-1.5f, 1.5f), randomUniformFloat(-1.5f, 1.5f), randomUniformFloat(-1.5f, 1.5f)
+        }, randomHalfDimensions());
+        box1.orientation = randomOrientation();
+        box2.orientation = randomOrientation();
+        pairs.emplace_back(std::move(box1), std::move(box2));
+    }
+
+    size_t hits = 0;
+    const size_t allocationsBefore = allocationCount.load();
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& [box1, box2] : pairs) {
+        hits += HmlPhysics::penetrationGjk(box1, box2).has_value();
+    }
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const size_t allocations = allocationCount.load() - allocationsBefore;
+
+    const double n = static_cast<double>(std::max(pairCount, size_t{ 1 }));
+    return MicroResult{
+        .pairs = pairCount,
+        .hits = hits,
+        .nanosPerPair = std::chrono::duration<double, std::nano>(finish - start).count() / n,
+        .allocationsPerPair = allocations / n,
+    };
+}
+// ============================================================================
+// ======================== Reporting =========================================
+// ============================================================================
+void printCsvHeader() noexcept {
+    std::cout << "scene,mode,broadphase,threads,objects,frames,stepMs,integrationUs,broadphaseUs,narrowphaseUs,solverUs,candidatePairs,pairsPerSec,speedup\n";
+}
+
+
+void printCsv(const Result& r) noexcept {
+    std::cout << r.scene << ',' << modeName(r.mode) << ',' << broadphaseName(r.broadphase) << ','
+        << r.threads << ',' << r.objects << ',' << r.frames << ','
+        << r.stepMillis << ',' << r.integrationMicros << ',' << r.broadphaseMicros << ',' << r.narrowphaseMicros << ',' << r.solverMicros << ','
+        << r.candidatePairs << ',' << r.pairsPerSecond << ',' << r.speedup << std::endl;
+}
+
+
+void printJson(const Result& r, bool first) noexcept {
+    std::cout << (first ? "  " : ",\n  ")
+        << "{\"scene\": \"" << r.scene << "\", \"mode\": \"" << modeName(r.mode)
+        << "\", \"broadphase\": \"" << broadphaseName(r.broadphase)
+        << "\", \"threads\": " << r.threads << ", \"objects\": " << r.objects << ", \"frames\": " << r.frames
+        << ", \"stepMs\": " << r.stepMillis << ", \"integrationUs\": " << r.integrationMicros
+        << ", \"broadphaseUs\": " << r.broadphaseMicros << ", \"narrowphaseUs\": " << r.narrowphaseMicros
+        << ", \"solverUs\": " << r.solverMicros
+        << ", \"candidatePairs\": " << r.candidatePairs << ", \"pairsPerSec\": " << r.pairsPerSecond
+        << ", \"speedup\": " << r.speedup << "}" << std::flush;
+}
+// ============================================================================
+// ======================== Arguments =========================================
+// ============================================================================
+std::vector<std::string> splitList(std::string_view list) noexcept {
+    std::vector<std::string> items;
+    std::stringstream stream{ std::string(list) };
+    std::string item;
+    while (std::getline(stream, item, ',')) if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+
+std::vector<size_t> splitNumbers(std::string_view list) noexcept {
+    std::vector<size_t> numbers;
+    for (const auto& item : splitList(list)) numbers.push_back(std::strtoull(item.c_str(), nullptr, 10));
+    return numbers;
+}
+
+
+bool parseArguments(int argc, char** argv, Config& config) noexcept {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "::> Missing value for " << arg << "\n";
+            return false;
+        }
+        const std::string_view value = argv[++i];
+        if      (arg == "--scenes")      config.scenes = splitList(value);
+        else if (arg == "--counts")      config.counts = splitNumbers(value);
+        else if (arg == "--modes")       config.modes = splitNumbers(value);
+        else if (arg == "--broadphases") config.broadphases = splitNumbers(value);
+        else if (arg == "--threads")     config.threads = splitNumbers(value);
+        else if (arg == "--frames")      config.frames = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        else if (arg == "--format")      config.json = (value == "json");
+        else if (arg == "--micro")       config.micro = value;
+        else if (arg == "--pairs")       config.pairs = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        else {
+            std::cerr << "::> Unknown argument " << arg << "\n";
+            return false;
+        }
+    }
+
+    for (const auto mode : config.modes) if (mode > static_cast<size_t>(HmlPhysics::Mode::AnotherThreadAndHelperThreads)) {
+        std::cerr << "::> Invalid Mode " << mode << "\n";
+        return false;
+    }
+    for (const auto broadphase : config.broadphases) if (broadphase > static_cast<size_t>(HmlPhysics::Broadphase::AabbTree)) {
+        std::cerr << "::> Invalid Broadphase " << broadphase << "\n";
+        return false;
+    }
+    if (config.threads.empty()) config.threads.push_back(0);
+    if (!config.micro.empty() && config.micro != "gjk") {
+        std::cerr << "::> Unknown microbenchmark " << config.micro << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+// ============================================================================
+// ============================================================================
+// ============================================================================
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArguments(argc, argv, config)) return 1;
+
+    if (!config.micro.empty()) {
+        const auto r = runGjkMicro(config.pairs);
+        if (config.json) {
+            std::cout << "{\"micro\": \"" << config.micro << "\", \"pairs\": " << r.pairs << ", \"hits\": " << r.hits
+                << ", \"nsPerPair\": " << r.nanosPerPair << ", \"allocationsPerPair\": " << r.allocationsPerPair << "}\n";
+        } else {
+            std::cout << "micro,pairs,hits,nsPerPair,allocationsPerPair\n";
+            std::cout << config.micro << ',' << r.pairs << ',' << r.hits << ','
+                << r.nanosPerPair << ',' << r.allocationsPerPair << std::endl;
+        }
+        return 0;
+    }
+
+    std::vector<const Scene*> scenes;
+    for (const auto& scene : allScenes()) {
+        const bool requested = config.scenes.empty()
+            || std::find(config.scenes.begin(), config.scenes.end(), scene.name) != config.scenes.end();
+        if (requested) scenes.push_back(&scene);
+    }
+    if (scenes.empty()) {
+        std::cerr << "::> No known scenes requested\n";
+        return 1;
+    }
+
+    if (config.json) std::cout << "[\n";
+    else printCsvHeader();
+    bool first = true;
+    for (const auto* scene : scenes) {
+        for (const auto count : config.counts) {
+            for (const auto modeIndex : config.modes) {
+                for (const auto broadphaseIndex : config.broadphases) {
+                    const auto mode = static_cast<HmlPhysics::Mode>(modeIndex);
+                    const auto broadphase = static_cast<HmlPhysics::Broadphase>(broadphaseIndex);
+                    const bool withHelperThreads = mode == HmlPhysics::Mode::SameThreadAndHelperThreads
+                                                || mode == HmlPhysics::Mode::AnotherThreadAndHelperThreads;
+                    // The thread count only matters with helper threads
+                    const size_t threadsToTry = withHelperThreads ? config.threads.size() : 1;
+                    double baseStepMillis = 0.0;
+                    for (size_t t = 0; t < threadsToTry; t++) {
+                        auto result = run(*scene, count, mode, broadphase, config.threads[t], config.frames);
+                        if (t == 0) baseStepMillis = result.stepMillis;
+                        result.speedup = (result.stepMillis > 0.0) ? baseStepMillis / result.stepMillis : 0.0;
+
+                        if (config.json) printJson(result, first);
+                        else printCsv(result);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    if (config.json) std::cout << "\n]\n";
+
+    return 0;
+}
@@ -604,6 +604,7 @@ bool Himmel::initPhysics() noexcept {
     // hmlPhysics = std::make_unique<HmlPhysics>(HmlPhysics::Mode::SameThread);
     // hmlPhysics = std::make_unique<HmlPhysics>(HmlPhysics::Mode::SameThreadAndHelperThreads);
     hmlPhysics = std::make_unique<HmlPhysics>(HmlPhysics::Mode::AnotherThread);
+    hmlPhysics->registerHeightfield(world->heightGrid());
 
     initPhysicsTestbench();
 
@@ -1254,7 +1255,9 @@ void Himmel::updateForDt(float dt, float sinceStart) noexcept {
 #if WITH_PHYSICS
     // Upload data from physics to entities
     for (const auto& [id, mm] : hmlPhysics->getModelMatrices()) {
-        physicsIdToEntity[id]->modelMatrix = mm;
+        // NOTE The terrain is drawn by its own renderer
+        const auto it = physicsIdToEntity.find(id);
+        if (it != physicsIdToEntity.end()) it->second->modelMatrix = mm;
     }
 #endif
 
@@ -90,6 +90,20 @@ struct Himmel {
             return res;
         }
 
+        // The samples of heightAt(), for the terrain collider
+        inline HmlPhysics::HeightGrid heightGrid() const noexcept {
+            HmlPhysics::HeightGrid grid{
+                .start = start,
+                .cellSize = (finish - start) / glm::vec2(heightmapSize.first, heightmapSize.second),
+                .countX = heightmapSize.first,
+                .countZ = heightmapSize.second,
+                .heights = {},
+            };
+            grid.heights.reserve(grid.countX * grid.countZ);
+            for (const auto& row : heightmap) grid.heights.insert(grid.heights.end(), row.begin(), row.end());
+            return grid;
+        }
+
         private:
         // Coord is [0..size-2]
         // t is [0..1)
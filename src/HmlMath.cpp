@@ -307,6 +307,18 @@ T dot(const vec3_t<T>& v1, const vec3_t<T>& v2) noexcept {
 template TF    dot(const vec3&     v1, const vec3&     v2) noexcept;
 template TF128 dot(const vec3_128& v1, const vec3_128& v2) noexcept;
 template TF256 dot(const vec3_256& v1, const vec3_256& v2) noexcept;
+
+template<typename T>
+vec3_t<T> cross(const vec3_t<T>& v1, const vec3_t<T>& v2) noexcept {
+    return vec3_t<T>(
+        sub(mul(v1.y, v2.z), mul(v1.z, v2.y)),
+        sub(mul(v1.z, v2.x), mul(v1.x, v2.z)),
+        sub(mul(v1.x, v2.y), mul(v1.y, v2.x)));
+}
+
+template vec3     cross(const vec3&     v1, const vec3&     v2) noexcept;
+template vec3_128 cross(const vec3_128& v1, const vec3_128& v2) noexcept;
+template vec3_256 cross(const vec3_256& v1, const vec3_256& v2) noexcept;
 // ============================================================================
 template std::ostream& operator<<(std::ostream& ostream, const vec3& v);
 template std::ostream& operator<<(std::ostream& ostream, const vec3_128& v);
@@ -5,6 +5,8 @@
 #include <immintrin.h>
 #include <array>
 #include <iostream>
+#include <new>
+#include <cstddef>
 
 #include "settings.h"
 #include "settings_simd.h"
@@ -32,6 +34,27 @@ using vec3     = vec3_t<TF>;
 using vec3_128 = vec3_t<TF128>;
 using vec3_256 = vec3_t<TF256>;
 
+
+// Allows std::vector to hold arrays that can be directly load()-ed into TF128/TF256
+template<typename T, size_t Alignment = ALIGN>
+struct AlignedAllocator {
+    using value_type = T;
+    template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    inline T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    inline void deallocate(T* ptr, size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
 template<typename T>
 std::ostream& operator<<(std::ostream& ostream, const vec3_t<T>& v);
 
@@ -101,6 +124,9 @@ vec3_t<T> normalize(const vec3_t<T>& v) noexcept;
 template<typename T>
 T dot(const vec3_t<T>& v1, const vec3_t<T>& v2) noexcept;
 
+template<typename T>
+vec3_t<T> cross(const vec3_t<T>& v1, const vec3_t<T>& v2) noexcept;
+
 } // namespace hml
 
 // float hml_hsum128(__m128 v) noexcept {
@@ -3,15 +3,10 @@
 
 void HmlPhysics::threadFunc() noexcept {
     while (!threadedData.terminate.load()) {
-        if (objects.empty()) threadedData.hasNewObjectsToRegister.wait(false); // wait until not false
-        const bool hasNewObjectsToRegister = threadedData.hasNewObjectsToRegister.exchange(false);
-        if (hasNewObjectsToRegister) {
-            const std::lock_guard<std::mutex> lock(threadedData.objectsToRegisterMutex);
-            assert((!threadedData.objectsToRegister.empty() || threadedData.terminate.load()) && "Empty register vector even though the flag indicated otherwise");
-            for (const auto& object : threadedData.objectsToRegister) {
-                internalRegisterObject(object);
-            }
-            threadedData.objectsToRegister.clear();
+        if (objects.empty()) {
+            threadedData.hasPendingCommands.wait(false); // wait until not false
+            drainCommands();
+            continue; // in case there was nothing to register
         }
 
         const float check = threadedData.accumulatedDt.load();
@@ -41,17 +36,15 @@ void HmlPhysics::threadFunc() noexcept {
             step(dt / threadedData.substeps);
         }
 
-        { // Update the up-to-date modelMatrices array for use by outside world
-            const std::lock_guard<std::mutex> lock(threadedData.modelMatricesMutex);
-            threadedData.modelMatrices.clear();
-            for (const auto& object : objects) threadedData.modelMatrices.push_back(std::make_pair(object.id, object.modelMatrix()));
-        }
+        // Update the up-to-date modelMatrices array for use by outside world
+        publishModelMatrices();
+        publishQuerySnapshot();
     }
     if constexpr (LOG_INFO) std::cout << ":> Physics thread terminated!\n";
 }
 
 
-HmlPhysics::HmlPhysics(Mode mode) noexcept : mode(mode) {
+HmlPhysics::HmlPhysics(Mode mode, Broadphase broadphase, size_t helperThreads) noexcept : mode(mode), broadphase(broadphase) {
     switch (mode) {
         case Mode::SameThread:
             if constexpr (LOG_INFO) std::cout << ":> Starting HmlPhysics in the same thread.\n";
@@ -69,9 +62,13 @@ HmlPhysics::HmlPhysics(Mode mode) noexcept : mode(mode) {
     }
 
     if (hasHelperThreads()) {
-        constexpr size_t THREAD_POOL_SIZE = 5;
-        threadPool.resize(THREAD_POOL_SIZE);
+        const size_t threadPoolSize = (helperThreads > 0)
+            ? helperThreads : std::max(std::thread::hardware_concurrency(), 1u);
+        threadPool.resize(threadPoolSize);
+        workers = threadPoolSize;
+        if constexpr (LOG_INFO) std::cout << ":> Physics uses " << threadPoolSize << " helper threads.\n";
     }
+    taskRanges = std::make_unique<TaskRange[]>(workerCount());
 
     if (hasSelfThread()) {
         thread = std::thread(&HmlPhysics::threadFunc, this);
@@ -95,12 +92,124 @@ void HmlPhysics::terminate() noexcept {
     // Notify (awake) all places that may be hanged due to waiting
     threadedData.accumulatedDt.store(1.0f); // because we wait for not 0
     threadedData.accumulatedDt.notify_one();
-    threadedData.hasNewObjectsToRegister.store(true); // because we wait for not false
-    threadedData.hasNewObjectsToRegister.notify_one();
+    threadedData.hasPendingCommands.store(true); // because we wait for not false
+    threadedData.hasPendingCommands.notify_one();
 
     thread.join();
 }
 // ============================================================================
+// ========================== Task scheduling =================================
+// ============================================================================
+template<typename F>
+void HmlPhysics::runTasks(size_t taskCount, const F& func) noexcept {
+    if (!hasHelperThreads()) {
+        for (size_t task = 0; task < taskCount; task++) func(task, 0);
+        return;
+    }
+
+    const auto pack = [](uint64_t begin, uint64_t end) { return (begin << 32) | end; };
+    const auto beginOf = [](uint64_t beginEnd) { return beginEnd >> 32; };
+    const auto endOf = [](uint64_t beginEnd) { return beginEnd & 0xFFFFFFFF; };
+    assert(taskCount <= 0xFFFFFFFF && "Too many tasks");
+
+    for (size_t worker = 0; worker < workers; worker++) {
+        const auto begin = taskCount * worker / workers;
+        const auto end = taskCount * (worker + 1) / workers;
+        taskRanges[worker].beginEnd.store(pack(begin, end), std::memory_order_relaxed);
+    }
+
+    const auto work = [&](size_t worker) {
+        auto& own = taskRanges[worker].beginEnd;
+        while (true) {
+            // Take tasks from the front of own range
+            auto current = own.load(std::memory_order_acquire);
+            while (beginOf(current) < endOf(current)) {
+                const auto task = beginOf(current);
+                if (own.compare_exchange_weak(current, pack(task + 1, endOf(current)), std::memory_order_acq_rel)) {
+                    func(task, worker);
+                    current = own.load(std::memory_order_acquire);
+                }
+            }
+
+            // Steal the back half of the largest range left
+            size_t victim = workers;
+            uint64_t victimRange = 0;
+            uint64_t largestSize = 0;
+            for (size_t other = 0; other < workers; other++) {
+                const auto range = taskRanges[other].beginEnd.load(std::memory_order_acquire);
+                const auto size = endOf(range) - std::min(beginOf(range), endOf(range));
+                if (size > largestSize) {
+                    victim = other;
+                    victimRange = range;
+                    largestSize = size;
+                }
+            }
+            if (victim == workers) return; // no work left anywhere
+
+            const auto stolenBegin = endOf(victimRange) - (largestSize + 1) / 2;
+            const auto victimRangeAfter = pack(beginOf(victimRange), stolenBegin);
+            if (taskRanges[victim].beginEnd.compare_exchange_strong(victimRange, victimRangeAfter, std::memory_order_acq_rel)) {
+                own.store(pack(stolenBegin, endOf(victimRange)), std::memory_order_release);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> results(workers);
+    for (size_t worker = 0; worker < workers; worker++) {
+        results[worker] = threadPool.push([worker, &work](int){ work(worker); });
+    }
+    for (auto& result : results) result.get();
+}
+// ============================================================================
+// ========================== Contact manifold ================================
+// ============================================================================
+void HmlPhysics::ContactManifold::add(const glm::vec3& p) noexcept {
+    if (count == CAPACITY) reduce();
+    points[count++] = p;
+}
+
+
+// Keeps the point furthest from the center, the point furthest from it, the
+// one making the largest triangle with those two and the one that extends
+// that triangle the most.
+void HmlPhysics::ContactManifold::reduce() noexcept {
+    if (count <= REDUCED) return;
+    const auto furthest = [&](const auto& metric) {
+        size_t best = 0;
+        float bestValue = std::numeric_limits<float>::lowest();
+        for (size_t i = 0; i < count; i++) {
+            const float value = metric(points[i]);
+            if (value > bestValue) {
+                bestValue = value;
+                best = i;
+            }
+        }
+        return points[best];
+    };
+
+    const auto center = avg(std::span(begin(), end()));
+    const auto p0 = furthest([&](const glm::vec3& p){ return glm::dot(p - center, p - center); });
+    const auto p1 = furthest([&](const glm::vec3& p){ return glm::dot(p - p0, p - p0); });
+    const auto p2 = furthest([&](const glm::vec3& p){
+        const auto c = glm::cross(p1 - p0, p - p0);
+        return glm::dot(c, c);
+    });
+    const auto normal = glm::cross(p1 - p0, p2 - p0);
+    const auto p3 = furthest([&](const glm::vec3& p){
+        // The area added outside of the edges of the triangle
+        return std::max({
+            -glm::dot(glm::cross(p1 - p0, p - p0), normal),
+            -glm::dot(glm::cross(p2 - p1, p - p1), normal),
+            -glm::dot(glm::cross(p0 - p2, p - p2), normal) });
+    });
+
+    points[0] = p0;
+    points[1] = p1;
+    points[2] = p2;
+    points[3] = p3;
+    count = REDUCED;
+}
+// ============================================================================
 // ========================== Abstract detectors ==============================
 // ============================================================================
 template<typename Arg1, typename Arg2>
@@ -240,7 +349,7 @@ std::optional<HmlPhysics::Detection> HmlPhysics::detectOrientedBoxesWithSat(cons
 
 
 
-    std::vector<glm::vec3> contactPoints;
+    ContactManifold contactPoints;
     // findContactPointsBoxes(p1, p2, orientationData2, contactPoints);
     // findContactPointsBoxes(p2, p1, orientationData1, contactPoints);
     findContactPointsBoxesAvxFastest(pointsPacked, orientationDataPacked, contactPoints);
@@ -336,93 +445,283 @@ std::optional<HmlPhysics::Detection> HmlPhysics::detectAxisAlignedBoxes(const Ob
 // ============================================================================
 // ===================== Process ==============================================
 // ============================================================================
-HmlPhysics::ProcessResult HmlPhysics::process(const Object& obj1, const Object& obj2) noexcept {
-    assert(!(obj1.isStationary() && obj2.isStationary()) && "Shouldn't've called process() with both objects being stationary");
+std::optional<HmlPhysics::Detection> HmlPhysics::detectPair(const Object& obj1, const Object& obj2) noexcept {
+    assert(!(obj1.isStationary() && obj2.isStationary()) && "Shouldn't've called detectPair() with both objects being stationary");
+    if      (obj1.isSphere() && obj2.isSphere()) return detect(obj1.asSphere(), obj2.asSphere());
+    else if (obj1.isBox()    && obj2.isSphere()) return detect(obj1.asBox(),    obj2.asSphere());
+    else if (obj1.isSphere() && obj2.isBox())    return detect(obj1.asSphere(), obj2.asBox());
+    else if (obj1.isBox()    && obj2.isBox())    return detect(obj1.asBox(),    obj2.asBox());
+    return std::nullopt;
+}
+// ============================================================================
+// ========================== Batched detectors ===============================
+// ============================================================================
+void HmlPhysics::Contacts::clear() noexcept {
+    pairs.clear();
+    dirXs.clear(); dirYs.clear(); dirZs.clear();
+    extents.clear();
+    pointEnds.clear();
+    pointXs.clear(); pointYs.clear(); pointZs.clear();
+}
 
-    // ================ Resolve intersection ================
-    // const auto mark1 = std::chrono::high_resolution_clock::now();
-    std::optional<Detection> detectionOpt = std::nullopt;
-    if      (obj1.isSphere() && obj2.isSphere()) detectionOpt = detect(obj1.asSphere(), obj2.asSphere());
-    else if (obj1.isBox()    && obj2.isSphere()) detectionOpt = detect(obj1.asBox(),    obj2.asSphere());
-    else if (obj1.isSphere() && obj2.isBox())    detectionOpt = detect(obj1.asSphere(), obj2.asBox());
-    else if (obj1.isBox()    && obj2.isBox())    detectionOpt = detect(obj1.asBox(),    obj2.asBox());
-    // const auto mark2 = std::chrono::high_resolution_clock::now();
 
-    if (!detectionOpt) return std::make_pair(ObjectAdjustment{}, ObjectAdjustment{});
-    const auto& [dir, extent, contactPoints] = *detectionOpt;
+void HmlPhysics::Contacts::push(const ObjectIndexPair& pair, const glm::vec3& dir, float extent, ContactManifold points) noexcept {
+    points.reduce();
+    pairs.push_back(pair);
+    dirXs.push_back(dir.x);
+    dirYs.push_back(dir.y);
+    dirZs.push_back(dir.z);
+    extents.push_back(extent);
+    for (const auto& point : points) {
+        pointXs.push_back(point.x);
+        pointYs.push_back(point.y);
+        pointZs.push_back(point.z);
+    }
+    pointEnds.push_back(static_cast<uint32_t>(pointXs.size()));
+}
 
-    const bool oneStationary = obj1.isStationary() || obj2.isStationary();
-    const auto positionAdjustment = dir * extent * (oneStationary ? 1.0f : 0.5f);
 
-    // ================ Resolve velocities ================
-    const auto obj1DP = obj1.dynamicProperties.value_or(Object::DynamicProperties{});
-    const auto obj2DP = obj2.dynamicProperties.value_or(Object::DynamicProperties{});
-    const auto relativeV = obj2DP.velocity - obj1DP.velocity;
-    // if (glm::dot(relativeV, dir) > 0.0f) {
-    //     // Objects are already moving apart
-    //     return std::make_pair(VelocitiesAdjustment{}, VelocitiesAdjustment{});
-    // }
-    const auto cp = avg(contactPoints);
-    const auto rap = cp - obj1.position;
-    const auto rbp = cp - obj2.position;
-    const auto a = glm::cross(obj1DP.invRotationalInertiaTensor * glm::cross(rap, dir), rap);
-    const auto b = glm::cross(obj2DP.invRotationalInertiaTensor * glm::cross(rbp, dir), rbp);
-    // e == 0 --- perfectly inelastic collision
-    // e == 1 --- perfectly elastic collision, no kinetic energy is dissipated
-    // const float e = std::min(obj1.restitution, obj2.restitution);
-    const float e = 0.9f; // restitution
-    const float nom = -(1.0f + e) * glm::dot(relativeV, dir);
-    const float denom = (obj1DP.invMass + obj2DP.invMass) + glm::dot(a + b, dir);
-    const float j = nom / denom;
-    const auto impulse = j * dir;
-
-    const float frictionCoeff = 50.0f;
-    glm::vec3 friction = frictionCoeff * extent * glm::normalize(relativeV);
-    friction = glm::vec3{0};
-
-    // std::cout << "Impulse = " << impulse << '\n';
-    // std::cout << "Dir = " << dir << " J = " << j << " denom = " << denom << " nom = " << nom << std::endl;
-    // std::cout << "RAP = " << rap << " RBP = " << rbp << " a = " << a << " b = " << b << std::endl;
-    // std::cout << "Delta1 = " << -glm::cross(rap, impulse) * obj1DP.invRotationalInertiaTensor << '\n';
-    // std::cout << "Delta2 = " << +glm::cross(rbp, impulse) * obj2DP.invRotationalInertiaTensor << '\n';
-    // std::cout << "-----------------------------------------------------------" << '\n';
+void HmlPhysics::Contacts::pushLanes(const ObjectIndexPair* lanePairs, int hitLanes,
+        const hml::vec3_256& dir, __m256 extent, const hml::vec3_256& point) noexcept {
+    alignas(32) float lanes[8][8];
+    _mm256_store_ps(lanes[0], dir.x);
+    _mm256_store_ps(lanes[1], dir.y);
+    _mm256_store_ps(lanes[2], dir.z);
+    _mm256_store_ps(lanes[3], extent);
+    _mm256_store_ps(lanes[4], point.x);
+    _mm256_store_ps(lanes[5], point.y);
+    _mm256_store_ps(lanes[6], point.z);
+    while (hitLanes) {
+        const int lane = std::countr_zero(static_cast<unsigned int>(hitLanes));
+        hitLanes &= hitLanes - 1;
+        pairs.push_back(lanePairs[lane]);
+        dirXs.push_back(lanes[0][lane]);
+        dirYs.push_back(lanes[1][lane]);
+        dirZs.push_back(lanes[2][lane]);
+        extents.push_back(lanes[3][lane]);
+        pointXs.push_back(lanes[4][lane]);
+        pointYs.push_back(lanes[5][lane]);
+        pointZs.push_back(lanes[6][lane]);
+        pointEnds.push_back(static_cast<uint32_t>(pointXs.size()));
+    }
+}
 
-    // const auto mark3 = std::chrono::high_resolution_clock::now();
-    // const auto step1Mks = std::chrono::duration_cast<std::chrono::microseconds>(mark2 - mark1).count();
-    // const auto step2Mks = std::chrono::duration_cast<std::chrono::microseconds>(mark3 - mark2).count();
-    // std::cout << "Detection=" << static_cast<float>(step1Mks)
-    //     << "mks. Resolve=" << static_cast<float>(step2Mks)
-    //     << "mks. (" << (obj1.isBox() ? "Box":"Sphere") << "--" << (obj2.isBox() ? "Box":"Sphere") << ")\n";
-    // if ((obj1.isBox() && obj2.isBox())) {
-    //     static float sum = 0.0f;
-    //     static int count = 0;
-    //     sum += static_cast<float>(step1Mks);
-    //     count++;
-    //     static int aa = 0;
-    //     if (aa++ == 70) {
-    //         aa = 0;
-    //         std::cout << (sum / static_cast<float>(count)) << "\n";
-    //         sum = 0.0f;
-    //         count = 0;
-    //     }
-    // }
 
-    return std::make_pair(
-        obj1.isStationary() ? ObjectAdjustment{} : ObjectAdjustment{
-            .id              = obj1.id,
-            .idOther         = obj2.id,
-            .position        = - positionAdjustment,
-            .velocity        = - impulse * obj1DP.invMass,
-            .angularMomentum = - glm::cross(rap, impulse - friction) * obj1DP.invRotationalInertiaTensor,
-        },
-        obj2.isStationary() ? ObjectAdjustment{} : ObjectAdjustment{
-            .id              = obj2.id,
-            .idOther         = obj1.id,
-            .position        = + positionAdjustment,
-            .velocity        = + impulse * obj2DP.invMass,
-            .angularMomentum = + glm::cross(rbp, impulse - friction) * obj2DP.invRotationalInertiaTensor,
-        }
-    );
+// Mirrors detect(const Object::Sphere&, const Object::Sphere&)
+void HmlPhysics::detectSpheresBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept {
+    alignas(32) static const __m256 HALF = _mm256_set1_ps(0.5f);
+    for (size_t i = 0; i < pairs.size(); i += Bodies::LANES) {
+        const size_t count = std::min(Bodies::LANES, pairs.size() - i);
+        // The unused lanes are left far apart, so they never intersect
+        alignas(32) float c1x[8] = {}, c1y[8] = {}, c1z[8] = {}, r1s[8] = {};
+        alignas(32) float c2x[8] = {}, c2y[8] = {}, c2z[8] = {}, r2s[8] = {};
+        for (size_t lane = 0; lane < Bodies::LANES; lane++) c2x[lane] = 1.0f;
+        for (size_t lane = 0; lane < count; lane++) {
+            const auto& s1 = objects[pairs[i + lane].first].asSphere();
+            const auto& s2 = objects[pairs[i + lane].second].asSphere();
+            c1x[lane] = s1.center.x; c1y[lane] = s1.center.y; c1z[lane] = s1.center.z; r1s[lane] = s1.radius;
+            c2x[lane] = s2.center.x; c2y[lane] = s2.center.y; c2z[lane] = s2.center.z; r2s[lane] = s2.radius;
+        }
+        alignas(32) const hml::vec3_256 c1(c1x, c1y, c1z);
+        alignas(32) const hml::vec3_256 c2(c2x, c2y, c2z);
+        const __m256 r1 = _mm256_load_ps(r1s);
+        const __m256 r2 = _mm256_load_ps(r2s);
+
+        alignas(32) const hml::vec3_256 c = c2 - c1;
+        const __m256 lengthC = _mm256_sqrt_ps(hml::dot(c, c));
+        const __m256 extent = _mm256_sub_ps(_mm256_add_ps(r1, r2), lengthC);
+        const int hitLanes = _mm256_movemask_ps(_mm256_cmp_ps(extent, _mm256_setzero_ps(), _CMP_GT_OQ));
+        if (hitLanes == 0) continue;
+
+        alignas(32) const hml::vec3_256 normC = c / hml::vec3_256(lengthC);
+        alignas(32) const hml::vec3_256 middlePoint = c1 + normC * hml::vec3_256(_mm256_add_ps(r1, _mm256_mul_ps(extent, HALF)));
+        contacts.pushLanes(&pairs[i], hitLanes, normC, extent, middlePoint);
+    }
+}
+
+
+// Mirrors detectOrientedBoxSphere()
+void HmlPhysics::detectBoxesSpheresBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept {
+    alignas(32) static const __m256 ONE = _mm256_set1_ps(1.0f);
+    alignas(32) static const __m256 HALF = _mm256_set1_ps(0.5f);
+    alignas(32) static const __m256 SIGN_BIT = _mm256_set1_ps(-0.0f);
+    for (size_t i = 0; i < pairs.size(); i += Bodies::LANES) {
+        const size_t count = std::min(Bodies::LANES, pairs.size() - i);
+        // The unused lanes hold a unit box and a point sphere far apart, so they never intersect
+        alignas(32) float bx[8] = {}, by[8] = {}, bz[8] = {};
+        alignas(32) float hx[8], hy[8], hz[8];
+        alignas(32) float axes[3][3][8] = {}; // [i/j/k][x/y/z][lane]
+        alignas(32) float sx[8], sy[8] = {}, sz[8] = {}, rs[8] = {};
+        for (size_t lane = 0; lane < Bodies::LANES; lane++) {
+            hx[lane] = hy[lane] = hz[lane] = 1.0f;
+            for (size_t a = 0; a < 3; a++) axes[a][a][lane] = 1.0f;
+            sx[lane] = 4.0f;
+        }
+        for (size_t lane = 0; lane < count; lane++) {
+            const auto boxIndex = pairs[i + lane].first;
+            const auto& b = objects[boxIndex].asBox();
+            const auto& s = objects[pairs[i + lane].second].asSphere();
+            const auto& [iAxis, jAxis, kAxis] = shapes.axes[boxIndex];
+            bx[lane] = b.center.x; by[lane] = b.center.y; bz[lane] = b.center.z;
+            hx[lane] = b.halfDimensions.x; hy[lane] = b.halfDimensions.y; hz[lane] = b.halfDimensions.z;
+            for (size_t a = 0; a < 3; a++) {
+                axes[0][a][lane] = iAxis[a];
+                axes[1][a][lane] = jAxis[a];
+                axes[2][a][lane] = kAxis[a];
+            }
+            sx[lane] = s.center.x; sy[lane] = s.center.y; sz[lane] = s.center.z; rs[lane] = s.radius;
+        }
+        alignas(32) const hml::vec3_256 boxCenter(bx, by, bz);
+        alignas(32) const hml::vec3_256 halfDimensions(hx, hy, hz);
+        alignas(32) const hml::vec3_256 sphereCenter(sx, sy, sz);
+        const __m256 radius = _mm256_load_ps(rs);
+        alignas(32) const hml::vec3_256 iNorm(axes[0][0], axes[0][1], axes[0][2]);
+        alignas(32) const hml::vec3_256 jNorm(axes[1][0], axes[1][1], axes[1][2]);
+        alignas(32) const hml::vec3_256 kNorm(axes[2][0], axes[2][1], axes[2][2]);
+
+        alignas(32) const hml::vec3_256 v = sphereCenter - boxCenter;
+        alignas(32) const hml::vec3_256 proj(hml::dot(v, iNorm), hml::dot(v, jNorm), hml::dot(v, kNorm));
+        alignas(32) const hml::vec3_256 dim = halfDimensions + hml::vec3_256(radius);
+        alignas(32) const hml::vec3_256 projAbs(
+            _mm256_andnot_ps(SIGN_BIT, proj.x),
+            _mm256_andnot_ps(SIGN_BIT, proj.y),
+            _mm256_andnot_ps(SIGN_BIT, proj.z));
+        // -dim < proj < dim on every axis
+        const __m256 inside = _mm256_and_ps(
+            _mm256_cmp_ps(projAbs.x, dim.x, _CMP_LT_OQ), _mm256_and_ps(
+            _mm256_cmp_ps(projAbs.y, dim.y, _CMP_LT_OQ),
+            _mm256_cmp_ps(projAbs.z, dim.z, _CMP_LT_OQ)));
+        const int hitLanes = _mm256_movemask_ps(inside);
+        if (hitLanes == 0) continue;
+
+        alignas(32) const hml::vec3_256 extent = dim - projAbs;
+        const __m256 minExtent = _mm256_min_ps(extent.x, _mm256_min_ps(extent.y, extent.z));
+        // Each axis along which the extent is the smallest contributes +-1 (with the sign of proj)
+        const auto axisFactor = [&](__m256 axisExtent, __m256 axisProj) {
+            const __m256 isMin = _mm256_cmp_ps(axisExtent, minExtent, _CMP_EQ_OQ);
+            return _mm256_or_ps(_mm256_and_ps(isMin, ONE), _mm256_and_ps(SIGN_BIT, axisProj));
+        };
+        alignas(32) const hml::vec3_256 dir =
+            iNorm * hml::vec3_256(axisFactor(extent.x, proj.x)) +
+            jNorm * hml::vec3_256(axisFactor(extent.y, proj.y)) +
+            kNorm * hml::vec3_256(axisFactor(extent.z, proj.z));
+        alignas(32) const hml::vec3_256 contactPoint = sphereCenter - dir * hml::vec3_256(_mm256_add_ps(radius, _mm256_mul_ps(minExtent, HALF)));
+        contacts.pushLanes(&pairs[i], hitLanes, dir, minExtent, contactPoint);
+    }
+}
+
+
+// Mirrors detectOrientedBoxesWithSat(). The overlap on an axis is computed
+// from the projected half-extents rather than from the projected vertices.
+// Besides the 6 face axes, the 9 edge--edge axes are tested as well, but only
+// to reject pairs early: the dir is still chosen among the face axes.
+void HmlPhysics::detectBoxesBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept {
+    alignas(32) static const __m256 SIGN_BIT = _mm256_set1_ps(-0.0f);
+    alignas(32) static const __m256 DEGENERATE_AXIS = _mm256_set1_ps(1e-6f);
+    for (size_t i = 0; i < pairs.size(); i += Bodies::LANES) {
+        const size_t count = std::min(Bodies::LANES, pairs.size() - i);
+        // The unused lanes hold two unit boxes far apart, so they never intersect
+        std::array<std::array<Object::Box::OrientationData, 2>, 8> orientations;
+        alignas(32) float cs[2][3][8] = {};
+        alignas(32) float hs[2][3][8];
+        alignas(32) float axes[2][3][3][8] = {}; // [box][i/j/k][x/y/z][lane]
+        for (size_t lane = 0; lane < Bodies::LANES; lane++) {
+            cs[1][0][lane] = 4.0f;
+            for (size_t b = 0; b < 2; b++) for (size_t a = 0; a < 3; a++) {
+                hs[b][a][lane] = 1.0f;
+                axes[b][a][a][lane] = 1.0f;
+            }
+        }
+        for (size_t lane = 0; lane < count; lane++) {
+            const std::array<uint32_t, 2> objectIndices{ pairs[i + lane].first, pairs[i + lane].second };
+            for (size_t b = 0; b < 2; b++) {
+                const auto& box = objects[objectIndices[b]].asBox();
+                orientations[lane][b] = shapes.axes[objectIndices[b]];
+                const auto& [iNorm, jNorm, kNorm] = orientations[lane][b];
+                for (size_t a = 0; a < 3; a++) {
+                    cs[b][a][lane] = box.center[a];
+                    hs[b][a][lane] = box.halfDimensions[a];
+                    axes[b][0][a][lane] = iNorm[a];
+                    axes[b][1][a][lane] = jNorm[a];
+                    axes[b][2][a][lane] = kNorm[a];
+                }
+            }
+        }
+        const auto loadVec3 = [](const float (&ps)[3][8]) { return hml::vec3_256(ps[0], ps[1], ps[2]); };
+        alignas(32) const hml::vec3_256 c1 = loadVec3(cs[0]);
+        alignas(32) const hml::vec3_256 c2 = loadVec3(cs[1]);
+        alignas(32) const hml::vec3_256 h1 = loadVec3(hs[0]);
+        alignas(32) const hml::vec3_256 h2 = loadVec3(hs[1]);
+        alignas(32) const std::array<hml::vec3_256, 3> axes1{ loadVec3(axes[0][0]), loadVec3(axes[0][1]), loadVec3(axes[0][2]) };
+        alignas(32) const std::array<hml::vec3_256, 3> axes2{ loadVec3(axes[1][0]), loadVec3(axes[1][1]), loadVec3(axes[1][2]) };
+        alignas(32) const hml::vec3_256 centers = c2 - c1;
+
+        const auto abs = [](__m256 v) { return _mm256_andnot_ps(SIGN_BIT, v); };
+        // Half the length of the Box projected onto the axis
+        const auto radiusAlong = [&](const hml::vec3_256& axis, const std::array<hml::vec3_256, 3>& boxAxes, const hml::vec3_256& h) {
+            return _mm256_add_ps(_mm256_mul_ps(abs(hml::dot(axis, boxAxes[0])), h.x), _mm256_add_ps(
+                                 _mm256_mul_ps(abs(hml::dot(axis, boxAxes[1])), h.y),
+                                 _mm256_mul_ps(abs(hml::dot(axis, boxAxes[2])), h.z)));
+        };
+        // min(max1 - min2, max2 - min1), scaled by the length of the axis
+        const auto overlapAlong = [&](const hml::vec3_256& axis) {
+            return _mm256_sub_ps(_mm256_add_ps(radiusAlong(axis, axes1, h1), radiusAlong(axis, axes2, h2)),
+                                 abs(hml::dot(centers, axis)));
+        };
+
+        __m256 intersect = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 minExtent = _mm256_set1_ps(std::numeric_limits<float>::max());
+        alignas(32) hml::vec3_256 dir;
+        for (const auto* faceAxes : { &axes1, &axes2 }) {
+            for (const auto& axis : *faceAxes) {
+                const __m256 extent = overlapAlong(axis);
+                intersect = _mm256_and_ps(intersect, _mm256_cmp_ps(extent, _mm256_setzero_ps(), _CMP_GT_OQ));
+                const __m256 smaller = _mm256_cmp_ps(extent, minExtent, _CMP_LT_OQ);
+                minExtent = _mm256_blendv_ps(minExtent, extent, smaller);
+                dir.x = _mm256_blendv_ps(dir.x, axis.x, smaller);
+                dir.y = _mm256_blendv_ps(dir.y, axis.y, smaller);
+                dir.z = _mm256_blendv_ps(dir.z, axis.z, smaller);
+            }
+            if (_mm256_movemask_ps(intersect) == 0) break;
+        }
+        if (_mm256_movemask_ps(intersect) == 0) continue;
+
+        for (const auto& axis1 : axes1) {
+            for (const auto& axis2 : axes2) {
+                alignas(32) const hml::vec3_256 axis = hml::cross(axis1, axis2);
+                // Parallel edges produce no axis and thus cannot separate
+                const __m256 degenerate = _mm256_cmp_ps(hml::dot(axis, axis), DEGENERATE_AXIS, _CMP_LT_OQ);
+                const __m256 overlaps = _mm256_cmp_ps(overlapAlong(axis), _mm256_setzero_ps(), _CMP_GT_OQ);
+                intersect = _mm256_and_ps(intersect, _mm256_or_ps(overlaps, degenerate));
+            }
+            if (_mm256_movemask_ps(intersect) == 0) break;
+        }
+        int hitLanes = _mm256_movemask_ps(intersect);
+        if (hitLanes == 0) continue;
+
+        // Make dir point from the first Box towards the second
+        const __m256 opposite = _mm256_cmp_ps(hml::dot(centers, dir), _mm256_setzero_ps(), _CMP_LT_OQ);
+        const __m256 flip = _mm256_and_ps(opposite, SIGN_BIT);
+        dir = hml::vec3_256(_mm256_xor_ps(dir.x, flip), _mm256_xor_ps(dir.y, flip), _mm256_xor_ps(dir.z, flip));
+        alignas(32) float dirs[3][8];
+        alignas(32) float extents[8];
+        dir.store(dirs[0], dirs[1], dirs[2]);
+        _mm256_store_ps(extents, minExtent);
+
+        // The contact points are searched for one pair at a time
+        while (hitLanes) {
+            const int lane = std::countr_zero(static_cast<unsigned int>(hitLanes));
+            hitLanes &= hitLanes - 1;
+            const auto& pair = pairs[i + lane];
+            std::array<glm::vec3, 8 * 2> pointsPacked;
+            shapes.cornersAt(pair.first,  static_cast<float*>(&pointsPacked[0].x));
+            shapes.cornersAt(pair.second, static_cast<float*>(&pointsPacked[8].x));
+            ContactManifold contactPoints;
+            findContactPointsBoxesAvxFastest(pointsPacked, orientations[lane], contactPoints);
+            if (contactPoints.empty()) continue;
+            contacts.push(pair, glm::vec3{ dirs[0][lane], dirs[1][lane], dirs[2][lane] }, extents[lane], contactPoints);
+        }
+    }
 }
 // ============================================================================
 // ===================== Main Update ==========================================
@@ -450,232 +749,2678 @@ HmlPhysics::ProcessResult HmlPhysics::process(const Object& obj1, const Object&
 // }
 
 
-void HmlPhysics::updateForDt(float dt) noexcept {
-    if (hasSelfThread()) {
-        threadedData.accumulatedDt += dt;
-        threadedData.accumulatedDt.notify_one();
-    } else {
-        // const float simulationSpeedFactor = 0.5f;
-        const float simulationSpeedFactor = 1.0f;
-        const uint8_t SUBSTEPS = 1;
-        const float subDt = dt / SUBSTEPS * simulationSpeedFactor;
-        for (uint8_t i = 0; i < SUBSTEPS; i++) step(subDt);
+void HmlPhysics::updateForDt(float dt) noexcept {
+    if (hasSelfThread()) {
+        threadedData.accumulatedDt += dt;
+        threadedData.accumulatedDt.notify_one();
+    } else {
+        // const float simulationSpeedFactor = 0.5f;
+        const float simulationSpeedFactor = 1.0f;
+        const uint8_t SUBSTEPS = 1;
+        const float subDt = dt / SUBSTEPS * simulationSpeedFactor;
+        for (uint8_t i = 0; i < SUBSTEPS; i++) step(subDt);
+        publishQuerySnapshot();
+    }
+}
+
+
+void HmlPhysics::step(float dt) noexcept {
+    const auto mark1 = std::chrono::high_resolution_clock::now();
+    // ======================== Commands ========================
+    if (hasSelfThread()) drainCommands();
+    // ======================== Advance state ========================
+    integrate(dt);
+    sweepFastBodies();
+    updateShapes();
+    applyBucketMoves();
+    const auto mark2 = std::chrono::high_resolution_clock::now();
+    // ======================== Broadphase ========================
+    switch (broadphase) {
+        case Broadphase::Grid:
+            reassignBuckets();
+            findGridPairs();
+            stepStats.candidatePairs = candidatePairs.size();
+            break;
+        case Broadphase::SweepAndPrune:
+            for (size_t bodyIndex = 0; bodyIndex < bodies.size(); bodyIndex++) {
+                if (!bodies.isAwake(bodyIndex)) continue; // has not moved
+                const auto objectIndex = bodies.objectIndices[bodyIndex];
+                sweepAndPrune.aabbs[objectIndex] = shapes.aabbs[objectIndex];
+            }
+            sweepAndPrune.update();
+            candidatePairs.clear();
+            sweepAndPrune.findPairs(candidatePairs);
+            stepStats.candidatePairs = candidatePairs.size();
+            break;
+        case Broadphase::AabbTree:
+            for (size_t bodyIndex = 0; bodyIndex < bodies.size(); bodyIndex++) {
+                if (!bodies.isAwake(bodyIndex)) continue; // has not moved
+                const auto objectIndex = bodies.objectIndices[bodyIndex];
+                dynamicTree.update(treeLeafOfObject[objectIndex], shapes.aabbs[objectIndex], dt * bodies.velocity(bodyIndex));
+            }
+            findTreePairs();
+            stepStats.candidatePairs = candidatePairs.size();
+            break;
+        default: assert(false && "Unhandled Broadphase");
+    }
+    const auto mark3 = std::chrono::high_resolution_clock::now();
+    // ======================== Narrowphase ========================
+    checkForAndHandleCollisions();
+    const auto mark4 = std::chrono::high_resolution_clock::now();
+    // ======================== Solver ========================
+    solveContacts();
+    updateIslands();
+    const auto mark5 = std::chrono::high_resolution_clock::now();
+
+    stepStats.integrationMicros = std::chrono::duration_cast<std::chrono::microseconds>(mark2 - mark1).count();
+    stepStats.broadphaseMicros  = std::chrono::duration_cast<std::chrono::microseconds>(mark3 - mark2).count();
+    stepStats.narrowphaseMicros = std::chrono::duration_cast<std::chrono::microseconds>(mark4 - mark3).count();
+    stepStats.solverMicros      = std::chrono::duration_cast<std::chrono::microseconds>(mark5 - mark4).count();
+    publishedStepStats.publish(stepStats);
+}
+
+
+void HmlPhysics::applyBucketMoves() noexcept {
+    // NOTE A Body moves at most once per step, so the order in which the
+    // workers happened to take the ranges does not matter here; the table
+    // sorts movedBodies itself
+    for (const auto& events : workerEvents) {
+        for (const auto& [bodyIndex, bounding] : events.bucketMoves) {
+            allBoundingBuckets[bodies.objectIndices[bodyIndex]] = bounding;
+            bucketTable.movedBodies.push_back(bodyIndex);
+        }
+    }
+}
+
+
+void HmlPhysics::reassignBuckets() noexcept {
+    bucketTable.rebuild(allBoundingBuckets, bodies.objectIndices);
+}
+
+
+void HmlPhysics::checkForAndHandleCollisions() noexcept {
+    processPairs(candidatePairs);
+    if (!heightfieldObjectIndices.empty()) detectHeightfieldContacts();
+}
+
+
+void HmlPhysics::findGridPairs() noexcept {
+    // Cut the rows into tasks of about the same number of pairs
+    constexpr size_t TASKS_PER_WORKER = 16;
+    const auto& table = bucketTable;
+    size_t totalPairCount = 0;
+    for (const auto slot : table.usedSlots) {
+        const size_t count = table.slots[slot].count;
+        totalPairCount += count * (count - std::min(count, size_t{1})) / 2;
+    }
+    const size_t pairsPerTask = std::max(totalPairCount / (workerCount() * TASKS_PER_WORKER), size_t{1});
+    gridTasks.clear();
+    size_t taskPairCount = 0;
+    bool taskOpen = false;
+    for (uint32_t usedSlotIndex = 0; usedSlotIndex < table.usedSlots.size(); usedSlotIndex++) {
+        const auto& slot = table.slots[table.usedSlots[usedSlotIndex]];
+        if (slot.count < 2) continue;
+        const uint32_t slotEnd = slot.begin + slot.count;
+        for (uint32_t position = slot.begin; position + 1 < slotEnd; position++) {
+            // An open task takes in the rows without pairs in between as well
+            if (taskOpen) {
+                gridTasks.back().endPosition = position + 1;
+            } else {
+                gridTasks.push_back(GridTask{ .usedSlotIndex = usedSlotIndex, .beginPosition = position, .endPosition = position + 1 });
+                taskOpen = true;
+            }
+            taskPairCount += slotEnd - position - 1;
+            if (taskPairCount >= pairsPerTask) {
+                taskPairCount = 0;
+                taskOpen = false;
+            }
+        }
+    }
+
+    threadPairKeys.resize(workerCount());
+    for (auto& keys : threadPairKeys) keys.clear();
+    runTasks(gridTasks.size(), [this, &table](size_t taskIndex, size_t worker) {
+        auto& keys = threadPairKeys[worker];
+        const auto& task = gridTasks[taskIndex];
+        auto usedSlotIndex = task.usedSlotIndex;
+        const BucketTable::Slot* slot = &table.slots[table.usedSlots[usedSlotIndex]];
+        for (uint32_t position = task.beginPosition; position < task.endPosition; position++) {
+            // The slots are laid out back to back in the order of usedSlots
+            while (position >= slot->begin + slot->count) slot = &table.slots[table.usedSlots[++usedSlotIndex]];
+            const uint32_t slotEnd = slot->begin + slot->count;
+
+            const auto index1 = table.objectIndices[position];
+            const bool stationary1 = objects[index1].isStationary();
+            for (uint32_t position2 = position + 1; position2 < slotEnd; position2++) {
+                const auto index2 = table.objectIndices[position2];
+                if (stationary1 && objects[index2].isStationary()) continue;
+                keys.push_back(packPair(index1, index2));
+            }
+        }
+    });
+
+    // Across levels: each Object against those in the coarser Buckets that
+    // contain its own; a stationary Object only looks for non-stationary ones
+    constexpr size_t OBJECTS_PER_TASK = 256;
+    const size_t levelTaskCount = gridLevels.count > 1 ? (objects.size() + OBJECTS_PER_TASK - 1) / OBJECTS_PER_TASK : 0;
+    runTasks(levelTaskCount, [this, &table](size_t task, size_t worker) {
+        auto& keys = threadPairKeys[worker];
+        const size_t end = std::min((task + 1) * OBJECTS_PER_TASK, objects.size());
+        for (size_t objectIndex = task * OBJECTS_PER_TASK; objectIndex < end; objectIndex++) {
+            const auto& [first, last] = allBoundingBuckets[objectIndex];
+            if (first.x > last.x) continue; // a Heightfield is in no Bucket
+            const bool stationary = objects[objectIndex].isStationary();
+            const auto& entryCounts = stationary ? table.dynamicEntryCountOfLevel : table.entryCountOfLevel;
+            for (Bucket::Level level = first.level + 1; level < gridLevels.count; level++) {
+                if (entryCounts[level] == 0) continue;
+                const auto levels = static_cast<Bucket::Level>(level - first.level);
+                const auto coarserFirst = first.coarser(levels);
+                const auto coarserLast = last.coarser(levels);
+                for (Bucket::Coord x = coarserFirst.x; x <= coarserLast.x; x++) {
+                    for (Bucket::Coord y = coarserFirst.y; y <= coarserLast.y; y++) {
+                        for (Bucket::Coord z = coarserFirst.z; z <= coarserLast.z; z++) {
+                            const auto* slot = table.findSlot(Bucket{ .x = x, .y = y, .z = z, .level = level });
+                            if (!slot) continue;
+                            for (const auto index2 : table.objectIndicesIn(*slot)) {
+                                if (stationary && objects[index2].isStationary()) continue;
+                                keys.push_back(packPair(static_cast<uint32_t>(objectIndex), index2));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    pairKeys.clear();
+    for (const auto& keys : threadPairKeys) pairKeys.insert(pairKeys.end(), keys.cbegin(), keys.cend());
+    sortUniquePairKeys();
+}
+
+
+void HmlPhysics::sortUniquePairKeys() noexcept {
+    constexpr int MAX_DIGIT_BITS = 11;
+    constexpr size_t MAX_DIGIT_COUNT = 1 << MAX_DIGIT_BITS;
+    // NOTE Each pass is stable only because every chunk of keys is handled as a
+    // whole by a single task and the chunks are laid out in order
+    constexpr size_t KEYS_PER_CHUNK = 16384;
+
+    const size_t keyCount = pairKeys.size();
+    const size_t chunkCount = std::max((keyCount + KEYS_PER_CHUNK - 1) / KEYS_PER_CHUNK, size_t{1});
+    const auto chunkBegin = [&](size_t chunk) { return chunk * KEYS_PER_CHUNK; };
+    const auto chunkEnd   = [&](size_t chunk) { return std::min((chunk + 1) * KEYS_PER_CHUNK, keyCount); };
+
+    // Only the low bits of each of the two indices ever vary, so cover just
+    // those (in each half of the key) with as few equally wide digits as possible
+    PairKey anyBits = 0;
+    PairKey allBits = ~PairKey{0};
+    for (const auto key : pairKeys) {
+        anyBits |= key;
+        allBits &= key;
+    }
+    const PairKey varyingBits = anyBits ^ allBits;
+    struct Pass {
+        int shift;
+        int bits;
+    };
+    std::vector<Pass> passes;
+    for (const int halfShift : { 0, 32 }) {
+        const auto varyingInHalf = static_cast<uint32_t>(varyingBits >> halfShift);
+        if (varyingInHalf == 0) continue;
+        const int low = std::countr_zero(varyingInHalf);
+        const int width = std::bit_width(varyingInHalf) - low;
+        const int passCount = (width + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+        const int bits = (width + passCount - 1) / passCount;
+        for (int i = 0; i < passCount; i++) passes.push_back(Pass{ .shift = halfShift + low + i * bits, .bits = bits });
+    }
+
+    std::vector<std::array<uint32_t, MAX_DIGIT_COUNT>> offsets(chunkCount);
+    pairKeysScratch.resize(keyCount);
+    for (const auto [shift, bits] : passes) {
+        const size_t digitCount = size_t{1} << bits;
+        const PairKey digitMask = digitCount - 1;
+
+        // Histogram of each chunk
+        runTasks(chunkCount, [&](size_t chunk, size_t) {
+            auto& counts = offsets[chunk];
+            std::fill_n(counts.begin(), digitCount, 0);
+            for (size_t i = chunkBegin(chunk); i < chunkEnd(chunk); i++) counts[(pairKeys[i] >> shift) & digitMask]++;
+        });
+        // Where each chunk puts each digit; ordered by digit and then by chunk, which keeps the sort stable
+        uint32_t offset = 0;
+        for (size_t digit = 0; digit < digitCount; digit++) {
+            for (auto& counts : offsets) {
+                const auto count = counts[digit];
+                counts[digit] = offset;
+                offset += count;
+            }
+        }
+        runTasks(chunkCount, [&](size_t chunk, size_t) {
+            auto& counts = offsets[chunk];
+            for (size_t i = chunkBegin(chunk); i < chunkEnd(chunk); i++) {
+                const auto key = pairKeys[i];
+                pairKeysScratch[counts[(key >> shift) & digitMask]++] = key;
+            }
+        });
+        std::swap(pairKeys, pairKeysScratch);
+    }
+
+    pairKeys.erase(std::unique(pairKeys.begin(), pairKeys.end()), pairKeys.end());
+    candidatePairs.resize(pairKeys.size());
+    for (size_t i = 0; i < pairKeys.size(); i++) candidatePairs[i] = unpackPair(pairKeys[i]);
+}
+
+
+void HmlPhysics::processPairs(std::span<const ObjectIndexPair> pairs) noexcept {
+    // The cost of a pair does not vary much, so fixed-size tasks are good enough
+    constexpr size_t PAIRS_PER_TASK = 256;
+    const size_t taskCount = (pairs.size() + PAIRS_PER_TASK - 1) / PAIRS_PER_TASK;
+    workerContacts.resize(workerCount());
+    for (auto& contacts : workerContacts) contacts.clear();
+    narrowphaseBatches.resize(workerCount());
+    for (auto& batch : narrowphaseBatches) batch.contacts.clear();
+    runTasks(taskCount, [this, pairs](size_t task, size_t worker) {
+        auto& contacts = workerContacts[worker];
+        auto& batch = narrowphaseBatches[worker];
+
+        batch.sphereSpherePairs.clear();
+        batch.boxSpherePairs.clear();
+        batch.boxBoxPairs.clear();
+        const size_t contactsBegin = batch.contacts.size();
+        const size_t end = std::min((task + 1) * PAIRS_PER_TASK, pairs.size());
+        for (size_t i = task * PAIRS_PER_TASK; i < end; i++) {
+            const auto& [index1, index2] = pairs[i];
+            const auto& obj1 = objects[index1];
+            const auto& obj2 = objects[index2];
+            if (!isAwake(obj1) && !isAwake(obj2)) continue; // neither could have moved
+            if      (obj1.isSphere() && obj2.isSphere()) batch.sphereSpherePairs.emplace_back(index1, index2);
+            else if (obj1.isBox()    && obj2.isSphere()) batch.boxSpherePairs.emplace_back(index1, index2);
+            else if (obj1.isSphere() && obj2.isBox())    batch.boxSpherePairs.emplace_back(index2, index1);
+            else if (obj1.isBox()    && obj2.isBox())    batch.boxBoxPairs.emplace_back(index1, index2);
+            else if (const auto detectionOpt = detectPair(obj1, obj2)) {
+                batch.contacts.push(pairs[i], detectionOpt->dir, detectionOpt->extent, detectionOpt->contactPoints);
+            }
+        }
+
+        detectSpheresBatched(batch.sphereSpherePairs, batch.contacts);
+        detectBoxesSpheresBatched(batch.boxSpherePairs, batch.contacts);
+        detectBoxesBatched(batch.boxBoxPairs, batch.contacts);
+
+        // Touching bodies end up in the same island
+        const auto& c = batch.contacts;
+        for (size_t i = contactsBegin; i < c.size(); i++) {
+            const auto& obj1 = objects[c.pairs[i].first];
+            const auto& obj2 = objects[c.pairs[i].second];
+            if (!obj1.isStationary() && !obj2.isStationary()) contacts.emplace_back(obj1.bodyIndex, obj2.bodyIndex);
+        }
+    });
+}
+// ============================================================================
+// ===================== Contact solver =======================================
+// ============================================================================
+void HmlPhysics::solveContacts() noexcept {
+    buildContactConstraints();
+
+    // Start from what held the contacts in the last step
+    forEachContactPairByColor([this](size_t pair) { warmStartContactPair(pair); });
+    for (int i = 0; i < solverSettings.velocityIterations; i++) {
+        forEachContactPairByColor([this](size_t pair) { solveContactPairVelocities(pair); });
+    }
+    for (int i = 0; i < solverSettings.positionIterations; i++) {
+        forEachContactPairByColor([this](size_t pair) { solveContactPairPositions(pair); });
+    }
+
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const auto& solverBody = solverBodies[i];
+        bodies.setVelocity(i, solverBody.velocity);
+        bodies.addAngularMomentum(i, solverBody.angularMomentumDelta);
+        if (solverBody.positionDelta == glm::vec3{0} && solverBody.rotationDelta == glm::vec3{0}) continue;
+
+        auto& object = objects[bodies.objectIndices[i]];
+        object.position += solverBody.positionDelta;
+        // orientation += cross(quat(0, rotationDelta), orientation) / 2
+        const auto& w = solverBody.rotationDelta;
+        const auto& q = object.orientation;
+        const glm::vec3 qv{ q.x, q.y, q.z };
+        const float newQw = q.w - 0.5f * glm::dot(w, qv);
+        const auto newQv = qv + 0.5f * (w * q.w + glm::cross(w, qv));
+        const float length = std::sqrt(newQw * newQw + glm::dot(newQv, newQv));
+        object.orientation = glm::quat{ newQw / length, newQv.x / length, newQv.y / length, newQv.z / length };
+        bodies.setPosition(i, object.position);
+        bodies.setOrientation(i, object.orientation);
+    }
+
+    const auto& cc = contactConstraints;
+    contactCache.resize(cc.points.size());
+    for (size_t pair = 0; pair < cc.size(); pair++) {
+        for (uint32_t p = cc.pointBegins[pair]; p < cc.pointBegins[pair + 1]; p++) {
+            contactCache[p] = CachedContact{
+                .key = cc.keys[pair],
+                .point = cc.points[p],
+                .normalImpulse = cc.normalImpulses[p],
+                .tangent1Impulse = cc.tangent1Impulses[p],
+                .tangent2Impulse = cc.tangent2Impulses[p],
+            };
+        }
+    }
+    std::sort(contactCache.begin(), contactCache.end(), [](const auto& c1, const auto& c2){ return c1.key < c2.key; });
+}
+
+
+void HmlPhysics::buildContactConstraints() noexcept {
+    const auto stationaryBody = stationarySolverBody();
+    solverBodies.resize(bodies.size() + 1);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        solverBodies[i] = SolverBody{
+            .velocity = bodies.velocity(i),
+            .angularVelocity = bodies.angularVelocity(i),
+            .angularMomentumDelta = glm::vec3{0},
+            .positionDelta = glm::vec3{0},
+            .rotationDelta = glm::vec3{0},
+            .invInertiaWorld = bodies.invInertiaWorld(i),
+            .invMass = objects[bodies.objectIndices[i]].dynamicProperties->invMass,
+        };
+    }
+    solverBodies[stationaryBody] = SolverBody{
+        .velocity = glm::vec3{0},
+        .angularVelocity = glm::vec3{0},
+        .angularMomentumDelta = glm::vec3{0},
+        .positionDelta = glm::vec3{0},
+        .rotationDelta = glm::vec3{0},
+        .invInertiaWorld = glm::mat3(0),
+        .invMass = 0.0f,
+    };
+    const auto solverBodyOf = [stationaryBody](const Object& object) {
+        return object.isStationary() ? stationaryBody : object.bodyIndex;
+    };
+
+    // Which worker has found which pair depends on the work stealing, so the
+    // pairs are put in the order of their keys first; otherwise the colors,
+    // and with them the order of solving, would change from run to run
+    contactOrder.clear();
+    for (uint32_t batch = 0; batch < narrowphaseBatches.size(); batch++) {
+        const auto& c = narrowphaseBatches[batch].contacts;
+        for (uint32_t i = 0; i < c.size(); i++) {
+            contactOrder.push_back(ContactRef{ .key = packPair(c.pairs[i].first, c.pairs[i].second), .batch = batch, .index = i });
+        }
+    }
+    std::sort(contactOrder.begin(), contactOrder.end(), [](const ContactRef& a, const ContactRef& b) { return a.key < b.key; });
+
+    // Color the pairs greedily, in that order.
+    // The stationary SolverBody is only ever read, so it never takes up a color.
+    solverBodyColors.assign(solverBodies.size(), 0);
+    contactColors.clear();
+    std::array<uint32_t, COLOR_COUNT + 1> pairCursors{};
+    std::array<uint32_t, COLOR_COUNT + 1> pointCursors{};
+    for (const auto& [key, batch, i] : contactOrder) {
+        const auto& c = narrowphaseBatches[batch].contacts;
+        const auto body1 = solverBodyOf(objects[c.pairs[i].first]);
+        const auto body2 = solverBodyOf(objects[c.pairs[i].second]);
+        const uint64_t usedColors = solverBodyColors[body1] | solverBodyColors[body2];
+        const auto color = static_cast<uint32_t>(std::countr_zero(~usedColors | (uint64_t{1} << OVERFLOW_COLOR)));
+        if (color != OVERFLOW_COLOR) {
+            if (body1 != stationaryBody) solverBodyColors[body1] |= uint64_t{1} << color;
+            if (body2 != stationaryBody) solverBodyColors[body2] |= uint64_t{1} << color;
+        }
+        contactColors.push_back(color);
+        pairCursors[color + 1]++;
+        pointCursors[color + 1] += c.pointEnds[i] - c.pointBegin(i);
+    }
+    for (uint32_t color = 0; color < COLOR_COUNT; color++) {
+        pairCursors[color + 1] += pairCursors[color];
+        pointCursors[color + 1] += pointCursors[color];
+    }
+
+    auto& cc = contactConstraints;
+    cc.colorBegins = pairCursors;
+    cc.resize(pairCursors[COLOR_COUNT], pointCursors[COLOR_COUNT]);
+    cc.pointBegins[cc.size()] = pointCursors[COLOR_COUNT];
+    size_t contactIndex = 0;
+    for (const auto& [pairKey, batch, i] : contactOrder) {
+        const auto& c = narrowphaseBatches[batch].contacts;
+        const auto color = contactColors[contactIndex++];
+        const auto pair = pairCursors[color]++;
+        const auto& [index1, index2] = c.pairs[i];
+        const auto& obj1 = objects[index1];
+        const auto& obj2 = objects[index2];
+        const auto body1 = solverBodyOf(obj1);
+        const auto body2 = solverBodyOf(obj2);
+        const auto& sb1 = solverBodies[body1];
+        const auto& sb2 = solverBodies[body2];
+        const glm::vec3 normal{ c.dirXs[i], c.dirYs[i], c.dirZs[i] };
+        // Any two directions perpendicular to the normal, but the same for the same normal (for warm starting)
+        const auto tangent1 = (std::abs(normal.x) >= 0.57735f)
+            ? glm::normalize(glm::vec3{ normal.y, -normal.x, 0.0f })
+            : glm::normalize(glm::vec3{ 0.0f, normal.z, -normal.y });
+        const auto tangent2 = glm::cross(normal, tangent1);
+        const auto key = packPair(obj1.id, obj2.id);
+
+        cc.keys[pair] = key;
+        cc.body1s[pair] = body1;
+        cc.body2s[pair] = body2;
+        cc.normals[pair] = normal;
+        cc.tangent1s[pair] = tangent1;
+        cc.tangent2s[pair] = tangent2;
+        cc.separations[pair] = -c.extents[i];
+        cc.pointBegins[pair] = pointCursors[color];
+
+        const auto effectiveMass = [&](const glm::vec3& r1, const glm::vec3& r2, const glm::vec3& dir) {
+            const auto rd1 = glm::cross(r1, dir);
+            const auto rd2 = glm::cross(r2, dir);
+            const float k = sb1.invMass + sb2.invMass
+                + glm::dot(rd1, sb1.invInertiaWorld * rd1) + glm::dot(rd2, sb2.invInertiaWorld * rd2);
+            return (k > 0.0f) ? 1.0f / k : 0.0f;
+        };
+        for (uint32_t point = c.pointBegin(i); point < c.pointEnds[i]; point++) {
+            const auto p = pointCursors[color]++;
+            const glm::vec3 position{ c.pointXs[point], c.pointYs[point], c.pointZs[point] };
+            const auto r1 = position - obj1.position;
+            const auto r2 = position - obj2.position;
+            const float normalV = glm::dot(sb2.velocityAt(r2) - sb1.velocityAt(r1), normal);
+            const auto* cached = findCachedContact(key, position);
+
+            cc.points[p] = position;
+            cc.r1s[p] = r1;
+            cc.r2s[p] = r2;
+            cc.normalMasses[p] = effectiveMass(r1, r2, normal);
+            cc.tangent1Masses[p] = effectiveMass(r1, r2, tangent1);
+            cc.tangent2Masses[p] = effectiveMass(r1, r2, tangent2);
+            cc.biases[p] = (normalV < -RESTITUTION_VELOCITY) ? -RESTITUTION * normalV : 0.0f;
+            cc.normalImpulses[p]   = cached ? cached->normalImpulse   : 0.0f;
+            cc.tangent1Impulses[p] = cached ? cached->tangent1Impulse : 0.0f;
+            cc.tangent2Impulses[p] = cached ? cached->tangent2Impulse : 0.0f;
+        }
+    }
+}
+
+
+void HmlPhysics::ContactConstraints::resize(size_t pairCount, size_t pointCount) noexcept {
+    keys.resize(pairCount);
+    body1s.resize(pairCount);
+    body2s.resize(pairCount);
+    normals.resize(pairCount);
+    tangent1s.resize(pairCount);
+    tangent2s.resize(pairCount);
+    separations.resize(pairCount);
+    pointBegins.resize(pairCount + 1);
+    points.resize(pointCount);
+    r1s.resize(pointCount);
+    r2s.resize(pointCount);
+    normalMasses.resize(pointCount);
+    tangent1Masses.resize(pointCount);
+    tangent2Masses.resize(pointCount);
+    biases.resize(pointCount);
+    normalImpulses.resize(pointCount);
+    tangent1Impulses.resize(pointCount);
+    tangent2Impulses.resize(pointCount);
+}
+
+
+template<typename F>
+void HmlPhysics::forEachContactPairByColor(const F& func) noexcept {
+    constexpr size_t PAIRS_PER_TASK = 64;
+    const auto& colorBegins = contactConstraints.colorBegins;
+    for (uint32_t color = 0; color < COLOR_COUNT; color++) {
+        const size_t begin = colorBegins[color];
+        const size_t end = colorBegins[color + 1];
+        if (begin == end) continue;
+        // The pairs of the overflow color may share Bodies
+        const size_t pairsPerTask = (color == OVERFLOW_COLOR) ? end - begin : PAIRS_PER_TASK;
+        const size_t taskCount = (end - begin + pairsPerTask - 1) / pairsPerTask;
+        runTasks(taskCount, [&](size_t task, size_t) {
+            const size_t taskEnd = std::min(begin + (task + 1) * pairsPerTask, end);
+            for (size_t pair = begin + task * pairsPerTask; pair < taskEnd; pair++) func(pair);
+        });
+    }
+}
+
+
+void HmlPhysics::warmStartContactPair(size_t pair) noexcept {
+    auto& cc = contactConstraints;
+    const bool moves1 = cc.body1s[pair] != stationarySolverBody();
+    const bool moves2 = cc.body2s[pair] != stationarySolverBody();
+    auto& b1 = solverBodies[cc.body1s[pair]];
+    auto& b2 = solverBodies[cc.body2s[pair]];
+    for (uint32_t p = cc.pointBegins[pair]; p < cc.pointBegins[pair + 1]; p++) {
+        const auto impulse = cc.normalImpulses[p] * cc.normals[pair]
+            + cc.tangent1Impulses[p] * cc.tangent1s[pair]
+            + cc.tangent2Impulses[p] * cc.tangent2s[pair];
+        if (moves1) b1.applyImpulse(cc.r1s[p], -impulse);
+        if (moves2) b2.applyImpulse(cc.r2s[p], +impulse);
+    }
+}
+
+
+void HmlPhysics::solveContactPairVelocities(size_t pair) noexcept {
+    auto& cc = contactConstraints;
+    const bool moves1 = cc.body1s[pair] != stationarySolverBody();
+    const bool moves2 = cc.body2s[pair] != stationarySolverBody();
+    auto& b1 = solverBodies[cc.body1s[pair]];
+    auto& b2 = solverBodies[cc.body2s[pair]];
+    for (uint32_t p = cc.pointBegins[pair]; p < cc.pointBegins[pair + 1]; p++) {
+        const auto& r1 = cc.r1s[p];
+        const auto& r2 = cc.r2s[p];
+        // Moves the accumulated impulse along dir towards cancelling the velocity along it minus bias
+        const auto solve = [&](const glm::vec3& dir, float mass, float bias, float& impulse, float minImpulse, float maxImpulse) {
+            const float v = glm::dot(b2.velocityAt(r2) - b1.velocityAt(r1), dir);
+            const float newImpulse = std::clamp(impulse + mass * (bias - v), minImpulse, maxImpulse);
+            const auto delta = (newImpulse - impulse) * dir;
+            impulse = newImpulse;
+            if (moves1) b1.applyImpulse(r1, -delta);
+            if (moves2) b2.applyImpulse(r2, +delta);
+        };
+        // Friction goes first, so that not penetrating, which matters more, is solved last
+        const float maxFriction = FRICTION * cc.normalImpulses[p];
+        solve(cc.tangent1s[pair], cc.tangent1Masses[p], 0.0f, cc.tangent1Impulses[p], -maxFriction, maxFriction);
+        solve(cc.tangent2s[pair], cc.tangent2Masses[p], 0.0f, cc.tangent2Impulses[p], -maxFriction, maxFriction);
+        solve(cc.normals[pair], cc.normalMasses[p], cc.biases[p], cc.normalImpulses[p], 0.0f, std::numeric_limits<float>::max());
+    }
+}
+
+
+void HmlPhysics::solveContactPairPositions(size_t pair) noexcept {
+    auto& cc = contactConstraints;
+    const bool moves1 = cc.body1s[pair] != stationarySolverBody();
+    const bool moves2 = cc.body2s[pair] != stationarySolverBody();
+    auto& b1 = solverBodies[cc.body1s[pair]];
+    auto& b2 = solverBodies[cc.body2s[pair]];
+    const auto& normal = cc.normals[pair];
+    for (uint32_t p = cc.pointBegins[pair]; p < cc.pointBegins[pair + 1]; p++) {
+        const auto& r1 = cc.r1s[p];
+        const auto& r2 = cc.r2s[p];
+        // NOTE The separation is tracked for the pair as a whole, which is what the narrowphase reports
+        const float separation = cc.separations[pair] + glm::dot(b2.displacementAt(r2) - b1.displacementAt(r1), normal);
+        const float correction = std::clamp(POSITION_CORRECTION * (separation + CONTACT_SLOP), -MAX_POSITION_CORRECTION, 0.0f);
+        const auto impulse = -cc.normalMasses[p] * correction * normal;
+        if (moves1) b1.applyPositionImpulse(r1, -impulse);
+        if (moves2) b2.applyPositionImpulse(r2, +impulse);
+    }
+}
+
+
+// The closest point of the same pair in the last step, if close enough
+const HmlPhysics::CachedContact* HmlPhysics::findCachedContact(PairKey key, const glm::vec3& point) const noexcept {
+    auto cached = std::lower_bound(contactCache.begin(), contactCache.end(), key,
+        [](const CachedContact& c, PairKey k){ return c.key < k; });
+    const CachedContact* closest = nullptr;
+    float minDistance2 = CONTACT_MATCH_DISTANCE * CONTACT_MATCH_DISTANCE;
+    for (; cached != contactCache.end() && cached->key == key; ++cached) {
+        const auto d = cached->point - point;
+        const float distance2 = glm::dot(d, d);
+        if (distance2 < minDistance2) {
+            minDistance2 = distance2;
+            closest = &*cached;
+        }
+    }
+    return closest;
+}
+// ============================================================================
+// ===================== Bucket table =========================================
+// ============================================================================
+void HmlPhysics::BucketTable::rebuild(std::span<const Bucket::Bounding> boundings, std::span<const size_t> dynamicObjectIndices) noexcept {
+    const auto entryCountOf = [](const Bucket::Bounding& bounding) {
+        const auto& [first, second] = bounding;
+        return static_cast<size_t>(second.x - first.x + 1) *
+               static_cast<size_t>(second.y - first.y + 1) *
+               static_cast<size_t>(second.z - first.z + 1);
+    };
+    size_t dynamicEntryCount = 0;
+    for (const auto objectIndex : dynamicObjectIndices) dynamicEntryCount += entryCountOf(boundings[objectIndex]);
+
+    // Keep the load factor at or below 1/2 even if every dynamic entry gets a new
+    // Bucket, and drop the keys once most of them are of Buckets left empty
+    // (with cells smaller than they move in a few steps, Bodies leave many behind)
+    const bool fullRebuild = needsFullRebuild
+        || 2 * (usedSlots.size() + dynamicEntryCount) > slots.size()
+        || usedSlots.size() > 2 * nonEmptySlotCount + 64;
+    const size_t previousBodyCount = fullRebuild || entryBeginOfBody.empty() ? 0 : entryBeginOfBody.size() - 1;
+    if (!fullRebuild && !staticEntriesChanged && movedBodies.empty() && previousBodyCount == dynamicObjectIndices.size()) return; // nothing has changed
+    staticEntriesChanged = false;
+    if (fullRebuild) {
+        size_t staticEntryCount = 0;
+        for (const auto objectIndex : staticObjectIndices) staticEntryCount += entryCountOf(boundings[objectIndex]);
+        const size_t requiredSlotCount = std::bit_ceil(std::max(4 * (staticEntryCount + dynamicEntryCount), size_t{16}));
+        if (slots.size() < requiredSlotCount) slots.resize(requiredSlotCount);
+        for (auto& slot : slots) slot.key = EMPTY_KEY;
+        usedSlots.clear();
+
+        staticEntries.clear();
+        for (const auto objectIndex : staticObjectIndices) addEntries(objectIndex, boundings[objectIndex], staticEntries);
+        needsFullRebuild = false;
+    }
+
+    // Count the entries per Bucket
+    for (const auto slot : usedSlots) slots[slot].count = 0;
+    for (const auto& entry : staticEntries) slots[entry.slot].count++;
+    // Only the Bodies that have moved (or are new) look their Buckets up again
+    std::sort(movedBodies.begin(), movedBodies.end());
+    movedBodies.erase(std::unique(movedBodies.begin(), movedBodies.end()), movedBodies.end());
+    auto moved = movedBodies.begin();
+    std::swap(entries, previousEntries);
+    entries.clear();
+    std::swap(entryBeginOfBody, previousEntryBeginOfBody);
+    entryBeginOfBody.resize(dynamicObjectIndices.size() + 1);
+    for (size_t bodyIndex = 0; bodyIndex < dynamicObjectIndices.size(); bodyIndex++) {
+        const bool hasMoved = moved != movedBodies.end() && *moved == bodyIndex;
+        if (hasMoved) ++moved;
+        entryBeginOfBody[bodyIndex] = static_cast<uint32_t>(entries.size());
+        if (bodyIndex < previousBodyCount && !hasMoved) {
+            entries.insert(entries.end(),
+                previousEntries.begin() + previousEntryBeginOfBody[bodyIndex],
+                previousEntries.begin() + previousEntryBeginOfBody[bodyIndex + 1]);
+        } else {
+            const auto objectIndex = dynamicObjectIndices[bodyIndex];
+            addEntries(static_cast<uint32_t>(objectIndex), boundings[objectIndex], entries);
+        }
+    }
+    entryBeginOfBody.back() = static_cast<uint32_t>(entries.size());
+    movedBodies.clear();
+    dynamicEntryCountOfLevel.fill(0);
+    for (const auto& entry : entries) {
+        auto& slot = slots[entry.slot];
+        slot.count++;
+        dynamicEntryCountOfLevel[slot.bucket.level]++;
+    }
+    entryCountOfLevel = dynamicEntryCountOfLevel;
+    for (const auto& entry : staticEntries) entryCountOfLevel[slots[entry.slot].bucket.level]++;
+
+    // Find where each Bucket starts, then scatter the entries into place
+    uint32_t offset = 0;
+    nonEmptySlotCount = 0;
+    for (const auto slot : usedSlots) {
+        slots[slot].begin = offset;
+        offset += slots[slot].count;
+        nonEmptySlotCount += slots[slot].count > 0;
+        slots[slot].count = 0; // used as the fill cursor below
+    }
+    objectIndices.resize(offset);
+    for (const auto* src : { &staticEntries, &entries }) {
+        for (const auto& entry : *src) {
+            auto& slot = slots[entry.slot];
+            objectIndices[slot.begin + slot.count++] = entry.objectIndex;
+        }
+    }
+}
+
+
+void HmlPhysics::BucketTable::addEntries(uint32_t objectIndex, const Bucket::Bounding& bounding, std::vector<Entry>& dst) noexcept {
+    const auto& [first, second] = bounding;
+    for (Bucket::Coord x = first.x; x <= second.x; x++) {
+        for (Bucket::Coord y = first.y; y <= second.y; y++) {
+            for (Bucket::Coord z = first.z; z <= second.z; z++) {
+                dst.push_back(Entry{ .slot = findOrInsertSlot(Bucket{ .x = x, .y = y, .z = z, .level = first.level }), .objectIndex = objectIndex });
+            }
+        }
+    }
+}
+
+
+void HmlPhysics::BucketTable::removeStatic(uint32_t objectIndex) noexcept {
+    std::erase(staticObjectIndices, objectIndex);
+    std::erase_if(staticEntries, [objectIndex](const Entry& entry){ return entry.objectIndex == objectIndex; });
+    staticEntriesChanged = true;
+}
+
+
+void HmlPhysics::BucketTable::renameStatic(uint32_t fromObjectIndex, uint32_t toObjectIndex) noexcept {
+    std::replace(staticObjectIndices.begin(), staticObjectIndices.end(), fromObjectIndex, toObjectIndex);
+    for (auto& entry : staticEntries) {
+        if (entry.objectIndex == fromObjectIndex) entry.objectIndex = toObjectIndex;
+    }
+    staticEntriesChanged = true;
+}
+
+
+const HmlPhysics::BucketTable::Slot* HmlPhysics::BucketTable::findSlot(const Bucket& bucket) const noexcept {
+    const auto key = bucket.packed();
+    const auto mask = slots.size() - 1;
+    for (auto index = firstSlotIndex(key, mask);; index = (index + 1) & mask) {
+        const auto& slot = slots[index];
+        if (slot.key == key) return &slot;
+        if (slot.key == EMPTY_KEY) return nullptr;
+    }
+}
+
+
+uint32_t HmlPhysics::BucketTable::findOrInsertSlot(const Bucket& bucket) noexcept {
+    const auto key = bucket.packed();
+    const auto mask = slots.size() - 1;
+    auto index = firstSlotIndex(key, mask);
+    while (true) {
+        auto& slot = slots[index];
+        if (slot.key == key) return static_cast<uint32_t>(index);
+        if (slot.key == EMPTY_KEY) {
+            slot.key = key;
+            slot.bucket = bucket;
+            slot.count = 0;
+            usedSlots.push_back(static_cast<uint32_t>(index));
+            return static_cast<uint32_t>(index);
+        }
+        index = (index + 1) & mask;
+    }
+}
+// ============================================================================
+// ===================== Sweep and prune ======================================
+// ============================================================================
+void HmlPhysics::SweepAndPrune::insert(uint32_t objectIndex, const Object::AABB& aabb, bool isStationary) noexcept {
+    assert(aabbs.size() == objectIndex && "Objects must be inserted in the order of their indices");
+    aabbs.push_back(aabb);
+    stationary.push_back(isStationary);
+    activeSlotOfObject.push_back(0);
+    // NOTE The values are set and the endpoints get into their places during update()
+    endpoints.push_back(Endpoint{ .value = 0.0f, .objectIndexAndEnd = objectIndex });
+    endpoints.push_back(Endpoint{ .value = 0.0f, .objectIndexAndEnd = objectIndex | Endpoint::END_BIT });
+}
+
+
+void HmlPhysics::SweepAndPrune::skip(uint32_t objectIndex) noexcept {
+    assert(aabbs.size() == objectIndex && "Objects must be inserted in the order of their indices");
+    aabbs.push_back(Object::AABB{ .begin = glm::vec3{0}, .end = glm::vec3{0} });
+    stationary.push_back(true);
+    activeSlotOfObject.push_back(0);
+}
+
+
+void HmlPhysics::SweepAndPrune::remove(uint32_t objectIndex) noexcept {
+    const auto lastIndex = static_cast<uint32_t>(aabbs.size() - 1);
+    // Keeps the rest of the endpoints sorted
+    std::erase_if(endpoints, [objectIndex](const Endpoint& endpoint){
+        return (endpoint.objectIndexAndEnd & ~Endpoint::END_BIT) == objectIndex;
+    });
+    if (objectIndex != lastIndex) {
+        for (auto& endpoint : endpoints) {
+            if ((endpoint.objectIndexAndEnd & ~Endpoint::END_BIT) != lastIndex) continue;
+            endpoint.objectIndexAndEnd = objectIndex | (endpoint.objectIndexAndEnd & Endpoint::END_BIT);
+        }
+        aabbs[objectIndex] = aabbs[lastIndex];
+        stationary[objectIndex] = stationary[lastIndex];
+        activeSlotOfObject[objectIndex] = activeSlotOfObject[lastIndex];
+    }
+    aabbs.pop_back();
+    stationary.pop_back();
+    activeSlotOfObject.pop_back();
+}
+
+
+void HmlPhysics::SweepAndPrune::update() noexcept {
+    // The dominant axis is the one along which the objects are spread the most,
+    // so that the fewest intervals overlap on it.
+    glm::vec3 sum{0};
+    glm::vec3 sumSqr{0};
+    for (const auto& endpoint : endpoints) {
+        if (endpoint.objectIndexAndEnd & Endpoint::END_BIT) continue;
+        const auto& aabb = aabbs[endpoint.objectIndexAndEnd];
+        const auto center = (aabb.begin + aabb.end) * 0.5f;
+        sum += center;
+        sumSqr += center * center;
+    }
+    const float count = std::max(static_cast<float>(endpoints.size() / 2), 1.0f);
+    const auto variance = sumSqr / count - (sum / count) * (sum / count);
+    int dominantAxis = 0;
+    if (variance.y > variance[dominantAxis]) dominantAxis = 1;
+    if (variance.z > variance[dominantAxis]) dominantAxis = 2;
+    // NOTE Require a clear winner so that we do not keep re-sorting from scratch
+    constexpr float SWITCH_AXIS_FACTOR = 1.5f;
+    const bool switchAxis = dominantAxis != axis && variance[dominantAxis] > SWITCH_AXIS_FACTOR * variance[axis];
+    if (switchAxis) axis = dominantAxis;
+
+    for (auto& endpoint : endpoints) {
+        const auto& aabb = aabbs[endpoint.objectIndexAndEnd & ~Endpoint::END_BIT];
+        const bool isEnd = endpoint.objectIndexAndEnd & Endpoint::END_BIT;
+        endpoint.value = isEnd ? aabb.end[axis] : aabb.begin[axis];
+    }
+
+    if (switchAxis) {
+        std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& e1, const Endpoint& e2){
+            return e1.value < e2.value;
+        });
+        return;
+    }
+
+    // Insertion sort, which is almost linear thanks to frame-to-frame coherence
+    for (size_t i = 1; i < endpoints.size(); i++) {
+        const auto endpoint = endpoints[i];
+        size_t j = i;
+        for (; j > 0 && endpoints[j - 1].value > endpoint.value; j--) {
+            endpoints[j] = endpoints[j - 1];
+        }
+        endpoints[j] = endpoint;
+    }
+}
+
+
+void HmlPhysics::SweepAndPrune::findPairs(std::vector<ObjectIndexPair>& pairs) noexcept {
+    const int axisA = (axis + 1) % 3;
+    const int axisB = (axis + 2) % 3;
+    static const float ALL_BITS = std::bit_cast<float>(0xFFFFFFFFu);
+    static const float NEVER_MIN = std::numeric_limits<float>::max();
+    static const float NEVER_MAX = std::numeric_limits<float>::lowest();
+
+    size_t activeCount = 0;
+    std::fill(activeMinAs.begin(), activeMinAs.end(), NEVER_MIN);
+    std::fill(activeMaxAs.begin(), activeMaxAs.end(), NEVER_MAX);
+    std::fill(activeMinBs.begin(), activeMinBs.end(), NEVER_MIN);
+    std::fill(activeMaxBs.begin(), activeMaxBs.end(), NEVER_MAX);
+    activeObjectIndices.clear();
+
+    for (const auto& endpoint : endpoints) {
+        const uint32_t objectIndex = endpoint.objectIndexAndEnd & ~Endpoint::END_BIT;
+        if (endpoint.objectIndexAndEnd & Endpoint::END_BIT) {
+            // Remove from the active set by moving the last active one into its slot
+            const auto slot = activeSlotOfObject[objectIndex];
+            const auto last = --activeCount;
+            activeMinAs[slot] = activeMinAs[last];
+            activeMaxAs[slot] = activeMaxAs[last];
+            activeMinBs[slot] = activeMinBs[last];
+            activeMaxBs[slot] = activeMaxBs[last];
+            activeDynamicMasks[slot] = activeDynamicMasks[last];
+            activeObjectIndices[slot] = activeObjectIndices[last];
+            activeSlotOfObject[activeObjectIndices[slot]] = slot;
+            activeMinAs[last] = NEVER_MIN;
+            activeMaxAs[last] = NEVER_MAX;
+            activeMinBs[last] = NEVER_MIN;
+            activeMaxBs[last] = NEVER_MAX;
+            activeObjectIndices.pop_back();
+            continue;
+        }
+
+        // Test against all active intervals, 8 at a time
+        const auto& aabb = aabbs[objectIndex];
+        const __m256 minA = _mm256_set1_ps(aabb.begin[axisA]);
+        const __m256 maxA = _mm256_set1_ps(aabb.end[axisA]);
+        const __m256 minB = _mm256_set1_ps(aabb.begin[axisB]);
+        const __m256 maxB = _mm256_set1_ps(aabb.end[axisB]);
+        const bool isStationary = stationary[objectIndex];
+        for (size_t i = 0; i < activeCount; i += Bodies::LANES) {
+            __m256 overlap =                  _mm256_cmp_ps(minA, _mm256_load_ps(&activeMaxAs[i]), _CMP_LT_OQ);
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(&activeMinAs[i]), maxA, _CMP_LT_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(minB, _mm256_load_ps(&activeMaxBs[i]), _CMP_LT_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(&activeMinBs[i]), maxB, _CMP_LT_OQ));
+            if (isStationary) overlap = _mm256_and_ps(overlap, _mm256_load_ps(&activeDynamicMasks[i]));
+            for (auto mask = static_cast<uint32_t>(_mm256_movemask_ps(overlap)); mask; mask &= mask - 1) {
+                const auto other = activeObjectIndices[i + std::countr_zero(mask)];
+                pairs.emplace_back(std::min(objectIndex, other), std::max(objectIndex, other));
+            }
+        }
+
+        // Add to the active set
+        if (activeCount == activeMinAs.size()) {
+            for (auto array : { &activeMinAs, &activeMinBs }) array->resize(activeCount + Bodies::LANES, NEVER_MIN);
+            for (auto array : { &activeMaxAs, &activeMaxBs }) array->resize(activeCount + Bodies::LANES, NEVER_MAX);
+            activeDynamicMasks.resize(activeCount + Bodies::LANES, 0.0f);
+        }
+        const auto slot = activeCount++;
+        activeMinAs[slot] = aabb.begin[axisA];
+        activeMaxAs[slot] = aabb.end[axisA];
+        activeMinBs[slot] = aabb.begin[axisB];
+        activeMaxBs[slot] = aabb.end[axisB];
+        activeDynamicMasks[slot] = isStationary ? 0.0f : ALL_BITS;
+        activeObjectIndices.push_back(objectIndex);
+        activeSlotOfObject[objectIndex] = slot;
+    }
+    assert(activeCount == 0 && "Unbalanced endpoints");
+}
+// ============================================================================
+// ===================== Dynamic AABB tree ====================================
+// ============================================================================
+HmlPhysics::AabbTree::NodeIndex HmlPhysics::AabbTree::insert(uint32_t objectIndex, const Object::AABB& aabb) noexcept {
+    const auto leaf = allocateNode();
+    nodes[leaf].aabb = aabb;
+    nodes[leaf].objectIndex = objectIndex;
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+
+void HmlPhysics::AabbTree::remove(NodeIndex leaf) noexcept {
+    removeLeaf(leaf);
+    freeNode(leaf);
+    leafCount--;
+}
+
+
+bool HmlPhysics::AabbTree::update(NodeIndex leaf, const Object::AABB& aabb, const glm::vec3& displacement) noexcept {
+    if (contains(nodes[leaf].aabb, aabb)) return false;
+    removeLeaf(leaf);
+    nodes[leaf].aabb = fatten(aabb, displacement);
+    insertLeaf(leaf);
+    return true;
+}
+
+
+HmlPhysics::Object::AABB HmlPhysics::AabbTree::fatten(const Object::AABB& aabb, const glm::vec3& displacement) noexcept {
+    const auto extent = aabb.end - aabb.begin;
+    const float margin = FAT_MARGIN_RELATIVE * std::max(extent.x, std::max(extent.y, extent.z)) + FAT_MARGIN_ABSOLUTE;
+    const auto d = DISPLACEMENT_MULTIPLIER * displacement;
+    return Object::AABB{
+        .begin = aabb.begin - glm::vec3(margin) + glm::vec3(std::min(d.x, 0.0f), std::min(d.y, 0.0f), std::min(d.z, 0.0f)),
+        .end   = aabb.end   + glm::vec3(margin) + glm::vec3(std::max(d.x, 0.0f), std::max(d.y, 0.0f), std::max(d.z, 0.0f))
+    };
+}
+
+
+HmlPhysics::Object::AABB HmlPhysics::AabbTree::merged(const Object::AABB& aabb1, const Object::AABB& aabb2) noexcept {
+    return Object::AABB{
+        .begin = glm::vec3(std::min(aabb1.begin.x, aabb2.begin.x), std::min(aabb1.begin.y, aabb2.begin.y), std::min(aabb1.begin.z, aabb2.begin.z)),
+        .end   = glm::vec3(std::max(aabb1.end.x,   aabb2.end.x),   std::max(aabb1.end.y,   aabb2.end.y),   std::max(aabb1.end.z,   aabb2.end.z))
+    };
+}
+
+
+float HmlPhysics::AabbTree::surfaceArea(const Object::AABB& aabb) noexcept {
+    const auto e = aabb.end - aabb.begin;
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+
+bool HmlPhysics::AabbTree::contains(const Object::AABB& outer, const Object::AABB& inner) noexcept {
+    return outer.begin.x <= inner.begin.x && inner.end.x <= outer.end.x &&
+           outer.begin.y <= inner.begin.y && inner.end.y <= outer.end.y &&
+           outer.begin.z <= inner.begin.z && inner.end.z <= outer.end.z;
+}
+
+
+HmlPhysics::AabbTree::NodeIndex HmlPhysics::AabbTree::allocateNode() noexcept {
+    if (freeList == NULL_NODE) {
+        nodes.push_back(Node{});
+        return static_cast<NodeIndex>(nodes.size() - 1);
+    }
+    const auto node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node{};
+    return node;
+}
+
+
+void HmlPhysics::AabbTree::freeNode(NodeIndex node) noexcept {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+
+void HmlPhysics::AabbTree::insertLeaf(NodeIndex leaf) noexcept {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling by descending along the smallest surface area increase
+    const auto leafAabb = nodes[leaf].aabb;
+    NodeIndex sibling = root;
+    while (!nodes[sibling].isLeaf()) {
+        const auto& node = nodes[sibling];
+        const float area = surfaceArea(node.aabb);
+        const float combinedArea = surfaceArea(merged(node.aabb, leafAabb));
+        // Cost of creating a new parent for this node and the leaf
+        const float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+        const auto costOfDescendingInto = [&](NodeIndex child) {
+            const auto& c = nodes[child];
+            const float newArea = surfaceArea(merged(c.aabb, leafAabb));
+            return inheritanceCost + (c.isLeaf() ? newArea : newArea - surfaceArea(c.aabb));
+        };
+        const float costLeft  = costOfDescendingInto(node.left);
+        const float costRight = costOfDescendingInto(node.right);
+        if (cost < costLeft && cost < costRight) break;
+        sibling = (costLeft < costRight) ? node.left : node.right;
+    }
+
+    // Create a new parent for the sibling and the leaf
+    const auto oldParent = nodes[sibling].parent;
+    const auto newParent = allocateNode(); // NOTE invalidates references into nodes
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = merged(leafAabb, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent == NULL_NODE) {
+        root = newParent;
+    } else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = newParent;
+    } else {
+        nodes[oldParent].right = newParent;
+    }
+
+    refitFrom(nodes[leaf].parent);
+}
+
+
+void HmlPhysics::AabbTree::removeLeaf(NodeIndex leaf) noexcept {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    const auto parent = nodes[leaf].parent;
+    const auto grandParent = nodes[parent].parent;
+    const auto sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+        return;
+    }
+
+    if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+    else                                   nodes[grandParent].right = sibling;
+    refitFrom(grandParent);
+}
+
+
+void HmlPhysics::AabbTree::refitFrom(NodeIndex node) noexcept {
+    while (node != NULL_NODE) {
+        node = balance(node);
+        auto& n = nodes[node];
+        const auto& left = nodes[n.left];
+        const auto& right = nodes[n.right];
+        n.height = 1 + std::max(left.height, right.height);
+        n.aabb = merged(left.aabb, right.aabb);
+        node = n.parent;
+    }
+}
+
+
+HmlPhysics::AabbTree::NodeIndex HmlPhysics::AabbTree::balance(NodeIndex iA) noexcept {
+    auto& a = nodes[iA];
+    if (a.isLeaf() || a.height < 2) return iA;
+
+    const auto iB = a.left;
+    const auto iC = a.right;
+    auto& b = nodes[iB];
+    auto& c = nodes[iC];
+    const int32_t imbalance = c.height - b.height;
+
+    // Replaces iA with iNewTop in the parent of iA
+    const auto replaceInParent = [this](NodeIndex iA, NodeIndex iNewTop) {
+        const auto parent = nodes[iNewTop].parent;
+        if (parent == NULL_NODE) root = iNewTop;
+        else if (nodes[parent].left == iA) nodes[parent].left = iNewTop;
+        else nodes[parent].right = iNewTop;
+    };
+
+    // Rotate C up
+    if (imbalance > 1) {
+        const auto iF = c.left;
+        const auto iG = c.right;
+        auto& f = nodes[iF];
+        auto& g = nodes[iG];
+        c.left = iA;
+        c.parent = a.parent;
+        a.parent = iC;
+        replaceInParent(iA, iC);
+        // The taller grandchild stays with C, the other one goes to A
+        const bool keepF = f.height > g.height;
+        const auto iStay = keepF ? iF : iG;
+        const auto iMove = keepF ? iG : iF;
+        auto& stay = nodes[iStay];
+        auto& move = nodes[iMove];
+        c.right = iStay;
+        a.right = iMove;
+        move.parent = iA;
+        a.aabb = merged(b.aabb, move.aabb);
+        c.aabb = merged(a.aabb, stay.aabb);
+        a.height = 1 + std::max(b.height, move.height);
+        c.height = 1 + std::max(a.height, stay.height);
+        return iC;
+    }
+
+    // Rotate B up
+    if (imbalance < -1) {
+        const auto iD = b.left;
+        const auto iE = b.right;
+        auto& d = nodes[iD];
+        auto& e = nodes[iE];
+        b.left = iA;
+        b.parent = a.parent;
+        a.parent = iB;
+        replaceInParent(iA, iB);
+        // The taller grandchild stays with B, the other one goes to A
+        const bool keepD = d.height > e.height;
+        const auto iStay = keepD ? iD : iE;
+        const auto iMove = keepD ? iE : iD;
+        auto& stay = nodes[iStay];
+        auto& move = nodes[iMove];
+        b.right = iStay;
+        a.left = iMove;
+        move.parent = iA;
+        a.aabb = merged(c.aabb, move.aabb);
+        b.aabb = merged(a.aabb, stay.aabb);
+        a.height = 1 + std::max(c.height, move.height);
+        b.height = 1 + std::max(a.height, stay.height);
+        return iB;
+    }
+
+    return iA;
+}
+
+
+void HmlPhysics::AabbTree::selfPairs(NodeIndex node, std::vector<ObjectIndexPair>& pairs) const noexcept {
+    const auto& n = nodes[node];
+    if (n.isLeaf()) return;
+    selfPairs(n.left, pairs);
+    selfPairs(n.right, pairs);
+    crossPairs(*this, n.left, *this, n.right, pairs);
+}
+
+
+void HmlPhysics::AabbTree::crossPairs(const AabbTree& tree1, NodeIndex node1,
+                                      const AabbTree& tree2, NodeIndex node2,
+                                      std::vector<ObjectIndexPair>& pairs) noexcept {
+    const auto& n1 = tree1.nodes[node1];
+    const auto& n2 = tree2.nodes[node2];
+    if (!n1.aabb.intersects(n2.aabb)) return;
+    if (n1.isLeaf() && n2.isLeaf()) {
+        pairs.emplace_back(std::min(n1.objectIndex, n2.objectIndex), std::max(n1.objectIndex, n2.objectIndex));
+        return;
+    }
+
+    // Descend into the taller subtree
+    if (n2.isLeaf() || (!n1.isLeaf() && n1.height >= n2.height)) {
+        crossPairs(tree1, n1.left,  tree2, node2, pairs);
+        crossPairs(tree1, n1.right, tree2, node2, pairs);
+    } else {
+        crossPairs(tree1, node1, tree2, n2.left,  pairs);
+        crossPairs(tree1, node1, tree2, n2.right, pairs);
+    }
+}
+
+
+void HmlPhysics::findTreePairs() noexcept {
+    // Either the pairs within a single subtree (node1 == node2 in the same
+    // tree) or the pairs between two subtrees
+    struct Task {
+        const AabbTree* tree1;
+        AabbTree::NodeIndex node1;
+        const AabbTree* tree2;
+        AabbTree::NodeIndex node2;
+
+        inline bool isSelf() const noexcept { return tree1 == tree2 && node1 == node2; }
+        inline void run(std::vector<ObjectIndexPair>& pairs) const noexcept {
+            if (isSelf()) tree1->selfPairs(node1, pairs);
+            else AabbTree::crossPairs(*tree1, node1, *tree2, node2, pairs);
+        }
+    };
+
+    std::deque<Task> tasks;
+    if (dynamicTree.root != AabbTree::NULL_NODE) {
+        tasks.push_back(Task{ &dynamicTree, dynamicTree.root, &dynamicTree, dynamicTree.root });
+        if (staticTree.root != AabbTree::NULL_NODE) {
+            tasks.push_back(Task{ &dynamicTree, dynamicTree.root, &staticTree, staticTree.root });
+        }
+    }
+
+    candidatePairs.clear();
+    if (!hasHelperThreads()) {
+        for (const auto& task : tasks) task.run(candidatePairs);
+        return;
+    }
+
+    // Split the top of the traversal into enough tasks to keep all threads busy
+    constexpr size_t TASKS_PER_WORKER = 16;
+    const size_t targetTaskCount = workerCount() * TASKS_PER_WORKER;
+    std::vector<Task> finalTasks;
+    while (!tasks.empty() && tasks.size() + finalTasks.size() < targetTaskCount) {
+        const auto task = tasks.front();
+        tasks.pop_front();
+        const auto& n1 = task.tree1->nodes[task.node1];
+        const auto& n2 = task.tree2->nodes[task.node2];
+        if (task.isSelf()) {
+            if (n1.isLeaf()) continue; // no pairs within a single leaf
+            tasks.push_back(Task{ task.tree1, n1.left,  task.tree1, n1.left });
+            tasks.push_back(Task{ task.tree1, n1.right, task.tree1, n1.right });
+            tasks.push_back(Task{ task.tree1, n1.left,  task.tree1, n1.right });
+        } else if (!n1.aabb.intersects(n2.aabb)) {
+            continue;
+        } else if (n1.isLeaf() && n2.isLeaf()) {
+            finalTasks.push_back(task);
+        } else if (n2.isLeaf() || (!n1.isLeaf() && n1.height >= n2.height)) {
+            tasks.push_back(Task{ task.tree1, n1.left,  task.tree2, task.node2 });
+            tasks.push_back(Task{ task.tree1, n1.right, task.tree2, task.node2 });
+        } else {
+            tasks.push_back(Task{ task.tree1, task.node1, task.tree2, n2.left });
+            tasks.push_back(Task{ task.tree1, task.node1, task.tree2, n2.right });
+        }
+    }
+    finalTasks.insert(finalTasks.end(), tasks.cbegin(), tasks.cend());
+
+    threadCandidatePairs.resize(workerCount());
+    for (auto& pairs : threadCandidatePairs) pairs.clear();
+    runTasks(finalTasks.size(), [this, &finalTasks](size_t task, size_t worker) {
+        finalTasks[task].run(threadCandidatePairs[worker]);
+    });
+    for (const auto& pairs : threadCandidatePairs) {
+        candidatePairs.insert(candidatePairs.end(), pairs.cbegin(), pairs.cend());
+    }
+}
+
+
+// ============================================================================
+// ===================== Islands and sleeping =================================
+// ============================================================================
+HmlPhysics::Object::BodyIndex HmlPhysics::findIslandRoot(Object::BodyIndex body) noexcept {
+    while (islandParents[body] != body) {
+        islandParents[body] = islandParents[islandParents[body]]; // path halving
+        body = islandParents[body];
+    }
+    return body;
+}
+
+
+void HmlPhysics::wakeIsland(uint32_t sleepingIsland) noexcept {
+    auto& island = sleepingIslands[sleepingIsland];
+    for (const auto body : island) {
+        bodies.setAwake(body, true);
+        bodies.sleepCounters[body] = 0;
+        sleepingIslandOfBody[body] = NO_ISLAND;
+    }
+    island.clear();
+    freeSleepingIslands.push_back(sleepingIsland);
+}
+
+
+void HmlPhysics::wakeIslandsTouching(const Object::AABB& aabb) noexcept {
+    // Resting contacts may be apart by up to the slop, give or take
+    constexpr float MARGIN = 0.05f;
+    const Object::AABB inflated{ .begin = aabb.begin - MARGIN, .end = aabb.end + MARGIN };
+    for (size_t bodyIndex = 0; bodyIndex < bodies.size(); bodyIndex++) {
+        if (bodies.isAwake(bodyIndex)) continue;
+        if (!shapes.aabbs[bodies.objectIndices[bodyIndex]].intersects(inflated)) continue;
+        wakeIsland(sleepingIslandOfBody[bodyIndex]);
+    }
+}
+
+
+void HmlPhysics::updateIslands() noexcept {
+    const size_t count = bodies.size();
+    islandParents.resize(count);
+    std::iota(islandParents.begin(), islandParents.end(), 0);
+    sleepingIslandOfBody.resize(count, NO_ISLAND);
+
+    // Touching an awake body wakes up the whole island of a sleeping one
+    for (const auto& contacts : workerContacts) {
+        for (const auto& [body1, body2] : contacts) {
+            if (!bodies.isAwake(body1)) wakeIsland(sleepingIslandOfBody[body1]);
+            if (!bodies.isAwake(body2)) wakeIsland(sleepingIslandOfBody[body2]);
+            const auto root1 = findIslandRoot(body1);
+            const auto root2 = findIslandRoot(body2);
+            if (root1 != root2) islandParents[std::max(root1, root2)] = std::min(root1, root2);
+        }
+    }
+
+    // Count the steps for which each awake body has been slow
+    const auto& b = bodies;
+    size_t awakeCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!b.isAwake(i)) continue;
+        awakeCount++;
+        const auto velocity = b.velocity(i);
+        const auto angularVelocity = b.angularVelocity(i);
+        const bool slow = glm::dot(velocity, velocity) < SLEEP_LINEAR_VELOCITY * SLEEP_LINEAR_VELOCITY &&
+                          glm::dot(angularVelocity, angularVelocity) < SLEEP_ANGULAR_VELOCITY * SLEEP_ANGULAR_VELOCITY;
+        auto& sleepCounter = bodies.sleepCounters[i];
+        sleepCounter = slow ? std::min(sleepCounter + 1, SLEEP_STEPS) : 0;
+    }
+    stepStats.awakeBodies = awakeCount;
+
+    // An island falls asleep only once all of its bodies are ready to
+    islandMinSleepCounters.assign(count, SLEEP_STEPS);
+    for (size_t i = 0; i < count; i++) {
+        if (!b.isAwake(i)) continue;
+        auto& minSleepCounter = islandMinSleepCounters[findIslandRoot(i)];
+        minSleepCounter = std::min(minSleepCounter, bodies.sleepCounters[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!b.isAwake(i)) continue;
+        const auto root = findIslandRoot(i);
+        if (islandMinSleepCounters[root] < SLEEP_STEPS) continue;
+
+        // NOTE The root belongs to the same island, so it is going to sleep as well
+        if (sleepingIslandOfBody[root] == NO_ISLAND) {
+            if (freeSleepingIslands.empty()) {
+                sleepingIslandOfBody[root] = sleepingIslands.size();
+                sleepingIslands.emplace_back();
+            } else {
+                sleepingIslandOfBody[root] = freeSleepingIslands.back();
+                freeSleepingIslands.pop_back();
+            }
+        }
+        sleepingIslandOfBody[i] = sleepingIslandOfBody[root];
+        sleepingIslands[sleepingIslandOfBody[i]].push_back(i);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!b.isAwake(i) || sleepingIslandOfBody[i] == NO_ISLAND) continue;
+        bodies.setAwake(i, false);
+        bodies.velocityXs[i] = bodies.velocityYs[i] = bodies.velocityZs[i] = 0.0f;
+        bodies.angularMomentumXs[i] = bodies.angularMomentumYs[i] = bodies.angularMomentumZs[i] = 0.0f;
+        updateShapeOfSleepingBody(static_cast<Object::BodyIndex>(i));
+        stepStats.awakeBodies--;
+    }
+}
+
+
+void HmlPhysics::updateShapeOfSleepingBody(Object::BodyIndex bodyIndex) noexcept {
+    const auto objectIndex = bodies.objectIndices[bodyIndex];
+    shapes.update(objectIndex, objects[objectIndex]);
+    const auto& aabb = shapes.aabbs[objectIndex];
+    const auto bounding = boundingBucketsForAabb(aabb);
+    if (bounding != allBoundingBuckets[objectIndex]) {
+        allBoundingBuckets[objectIndex] = bounding;
+        bucketTable.movedBodies.push_back(bodyIndex);
+    }
+    switch (broadphase) {
+        case Broadphase::Grid:
+            break;
+        case Broadphase::SweepAndPrune:
+            sweepAndPrune.aabbs[objectIndex] = aabb;
+            break;
+        case Broadphase::AabbTree:
+            dynamicTree.update(treeLeafOfObject[objectIndex], aabb, glm::vec3{0});
+            break;
+        default: assert(false && "Unhandled Broadphase");
+    }
+}
+
+
+// ============================================================================
+// ===================== Continuous collision detection =======================
+// ============================================================================
+void HmlPhysics::sweepFastBodies() noexcept {
+    stepStats.sweptBodies = fastBodies.size();
+    if (fastBodies.empty()) return;
+    // Take in the Objects registered or removed since the last rebuild; the
+    // Bodies stay in the Buckets of the last step until after the sweep
+    reassignBuckets();
+    const auto& table = bucketTable;
+    for (const auto& [bodyIndex, start] : fastBodies) {
+        const auto objectIndex = bodies.objectIndices[bodyIndex];
+        auto& object = objects[objectIndex];
+        const auto finish = object.position;
+        const float radius = bodies.sweptRadii[bodyIndex];
+        const auto motion = finish - start;
+        const float motion2 = glm::dot(motion, motion);
+
+        // The other Bodies have moved since they were put into their Buckets,
+        // but (unless fast as well) by less than their swept radius, which is
+        // at most half a cell of their level, so one more cell around the
+        // motion on each level covers them. The fast ones are added as they are.
+        const Object::AABB swept{
+            .begin = glm::min(start, finish) - glm::vec3{radius},
+            .end   = glm::max(start, finish) + glm::vec3{radius},
+        };
+        const auto bucketRange = [&](Bucket::Level level) {
+            const auto margin = glm::vec3{gridLevels.cellSize(level)};
+            return std::make_pair(gridLevels.bucketAt(swept.begin - margin, level), gridLevels.bucketAt(swept.end + margin, level));
+        };
+        size_t bucketCount = 0;
+        for (Bucket::Level level = 0; level < gridLevels.count; level++) {
+            if (table.entryCountOfLevel[level] == 0) continue;
+            const auto [first, last] = bucketRange(level);
+            bucketCount += static_cast<size_t>(last.x - first.x + 1) *
+                           static_cast<size_t>(last.y - first.y + 1) *
+                           static_cast<size_t>(last.z - first.z + 1);
+        }
+        sweepCandidates.clear();
+        if (bucketCount > objects.size()) {
+            // Moving so far that scanning all the Objects is cheaper
+            for (uint32_t i = 0; i < objects.size(); i++) sweepCandidates.push_back(i);
+        } else {
+            for (Bucket::Level level = 0; level < gridLevels.count; level++) {
+                if (table.entryCountOfLevel[level] == 0) continue;
+                const auto [first, last] = bucketRange(level);
+                for (int x = first.x; x <= last.x; x++) {
+                    for (int y = first.y; y <= last.y; y++) {
+                        for (int z = first.z; z <= last.z; z++) {
+                            const auto* slot = table.findSlot(Bucket{
+                                .x = static_cast<Bucket::Coord>(x),
+                                .y = static_cast<Bucket::Coord>(y),
+                                .z = static_cast<Bucket::Coord>(z),
+                                .level = level });
+                            if (!slot) continue;
+                            const auto indices = table.objectIndicesIn(*slot);
+                            sweepCandidates.insert(sweepCandidates.end(), indices.begin(), indices.end());
+                        }
+                    }
+                }
+            }
+            for (const auto& fast : fastBodies) sweepCandidates.push_back(bodies.objectIndices[fast.bodyIndex]);
+            std::sort(sweepCandidates.begin(), sweepCandidates.end());
+            sweepCandidates.erase(std::unique(sweepCandidates.begin(), sweepCandidates.end()), sweepCandidates.end());
+        }
+
+        std::optional<SweepHit> firstHit;
+        for (const auto i : sweepCandidates) {
+            if (i == objectIndex) continue;
+            const auto& other = objects[i];
+            if (other.isHeightfield()) continue; // has its contacts found under the Body wherever it ends up
+            const float reach = radius + (other.isSphere() ? other.asSphere().radius : glm::length(other.asBox().halfDimensions));
+            const auto toCenter = other.position - start;
+            const auto toClosest = toCenter - motion * std::clamp(glm::dot(toCenter, motion) / motion2, 0.0f, 1.0f);
+            if (glm::dot(toClosest, toClosest) > reach * reach) continue;
+            const auto hitOpt = sweepSphere(start, finish, radius, other);
+            if (hitOpt && (!firstHit || hitOpt->t < firstHit->t)) firstHit = hitOpt;
+        }
+        if (!firstHit) continue;
+
+        // Sink in a bit, so that the narrowphase finds the contact
+        const auto position = start + (finish - start) * firstHit->t - firstHit->normal * (2.0f * CONTACT_SLOP);
+        object.position = position;
+        bodies.setPosition(bodyIndex, position);
+    }
+}
+
+
+std::optional<HmlPhysics::SweepHit> HmlPhysics::sweepSphere(const glm::vec3& start, const glm::vec3& finish,
+        float radius, const Object& object) noexcept {
+    if (object.isSphere()) {
+        // |start + t * d - center| == radius + other radius
+        const auto& sphere = object.asSphere();
+        const float r = radius + sphere.radius;
+        const auto d = finish - start;
+        const auto m = start - sphere.center;
+        const float c = glm::dot(m, m) - r * r;
+        if (c <= 0.0f) return std::nullopt; // already touching, the narrowphase handles that
+        const float a = glm::dot(d, d);
+        const float b = glm::dot(m, d);
+        const float discriminant = b * b - a * c;
+        if (b >= 0.0f || discriminant < 0.0f) return std::nullopt; // moving away or missing
+        const float t = (-b - std::sqrt(discriminant)) / a;
+        if (t > 1.0f) return std::nullopt;
+        return { SweepHit{ .t = t, .normal = glm::normalize(m + t * d) } };
+    }
+
+    // Against the faces of the Box inflated by radius that face the motion;
+    // the ones facing away can only be hit from the inside
+    const auto& box = object.asBox();
+    const auto [i, j, k] = box.orientationDataNormalized();
+    const auto h = box.halfDimensions + glm::vec3{radius};
+    const std::array<std::array<glm::vec3, 3>, 3> faces{{
+        { i * h.x, j * h.y, k * h.z },
+        { j * h.y, k * h.z, i * h.x },
+        { k * h.z, i * h.x, j * h.y },
+    }};
+    const auto d = finish - start;
+    const float length = glm::length(d);
+    if (length == 0.0f) return std::nullopt;
+    const auto dirNorm = d / length;
+    std::optional<SweepHit> firstHit;
+    for (const auto& [toFace, u, v] : faces) {
+        for (const float sign : { -1.0f, 1.0f }) {
+            const auto faceCenter = box.center + sign * toFace;
+            const auto normal = glm::normalize(sign * toFace);
+            if (glm::dot(dirNorm, normal) >= 0.0f) continue;
+            const auto intersectionOpt = linePlaneIntersection(start, dirNorm, faceCenter, normal);
+            if (!intersectionOpt) continue;
+            const float t = glm::dot(*intersectionOpt - start, dirNorm) / length;
+            if (t < 0.0f || t > 1.0f || (firstHit && t >= firstHit->t)) continue;
+            const auto A = faceCenter - u - v;
+            if (!pointInsideRect(*intersectionOpt, A, A + 2.0f * u, A + 2.0f * v)) continue;
+            firstHit = SweepHit{ .t = t, .normal = normal };
+        }
+    }
+    return firstHit;
+}
+// ============================================================================
+// ===================== Heightfields =========================================
+// ============================================================================
+HmlPhysics::HeightGrid::CellRange HmlPhysics::HeightGrid::cellsUnder(const Object::AABB& aabb) const noexcept {
+    // Clamped to a cell past either end first, so that far away AABBs do not overflow
+    const auto toCell = [](float offset, float size, size_t count) {
+        return static_cast<int>(std::floor(std::clamp(offset / size, -1.0f, static_cast<float>(count - 1))));
+    };
+    const int lastCellX = static_cast<int>(countX) - 2;
+    const int lastCellZ = static_cast<int>(countZ) - 2;
+    return CellRange{
+        .firstX = std::max(toCell(aabb.begin.x - start.x, cellSize.x, countX), 0),
+        .firstZ = std::max(toCell(aabb.begin.z - start.y, cellSize.y, countZ), 0),
+        .lastX  = std::min(toCell(aabb.end.x   - start.x, cellSize.x, countX), lastCellX),
+        .lastZ  = std::min(toCell(aabb.end.z   - start.y, cellSize.y, countZ), lastCellZ),
+    };
+}
+
+
+void HmlPhysics::detectHeightfieldContacts() noexcept {
+    // Appended to the contacts that processPairs() has found
+    constexpr size_t BODIES_PER_TASK = 64;
+    const size_t taskCount = (bodies.size() + BODIES_PER_TASK - 1) / BODIES_PER_TASK;
+    runTasks(taskCount, [this](size_t task, size_t worker) {
+        auto& contacts = narrowphaseBatches[worker].contacts;
+        const size_t end = std::min((task + 1) * BODIES_PER_TASK, bodies.size());
+        for (size_t bodyIndex = task * BODIES_PER_TASK; bodyIndex < end; bodyIndex++) {
+            if (!bodies.isAwake(bodyIndex)) continue; // has not moved
+            const auto objectIndex = static_cast<uint32_t>(bodies.objectIndices[bodyIndex]);
+            const auto& object = objects[objectIndex];
+            for (const auto heightfieldIndex : heightfieldObjectIndices) {
+                const auto& grid = heightGrids[objects[heightfieldIndex].asHeightfield().gridIndex];
+                const auto detectionOpt = object.isSphere()
+                    ? detectHeightfieldSphere(grid, object.asSphere())
+                    : detectHeightfieldBox(grid, object.asBox(), shapes.aabbs[objectIndex], shapes.axes[objectIndex], shapes.corners(objectIndex));
+                if (detectionOpt) {
+                    contacts.push(ObjectIndexPair(heightfieldIndex, objectIndex),
+                        detectionOpt->dir, detectionOpt->extent, detectionOpt->contactPoints);
+                }
+            }
+        }
+    });
+}
+
+
+// Against the closest point of each triangle: inside it, the Sphere is pushed
+// out along the triangle normal even from below; off it, only from above.
+// Only the deepest contact is kept, as a Sphere touches the surface at one point.
+std::optional<HmlPhysics::Detection> HmlPhysics::detectHeightfieldSphere(const HeightGrid& grid, const Object::Sphere& s) noexcept {
+    const auto range = grid.cellsUnder(s.aabb());
+    if (range.empty()) return std::nullopt;
+
+    alignas(32) static const __m256 ZERO = _mm256_setzero_ps();
+    alignas(32) static const __m256 ONE = _mm256_set1_ps(1.0f);
+    alignas(32) static const __m256 EPSILON = _mm256_set1_ps(1e-6f);
+    alignas(32) const hml::vec3_256 center(
+        _mm256_set1_ps(s.center.x),
+        _mm256_set1_ps(s.center.y),
+        _mm256_set1_ps(s.center.z));
+    const __m256 radius = _mm256_set1_ps(s.radius);
+    const __m256 negRadius = _mm256_set1_ps(-s.radius);
+
+    float bestDepth = 0.0f;
+    glm::vec3 bestDir{0};
+    alignas(32) float ax[8], ay[8], az[8], bx[8], by[8], bz[8], cx[8], cy[8], cz[8];
+    const auto testTriangles = [&](size_t count) {
+        alignas(32) const hml::vec3_256 a(ax, ay, az);
+        alignas(32) const hml::vec3_256 b(bx, by, bz);
+        alignas(32) const hml::vec3_256 c(cx, cy, cz);
+        alignas(32) const hml::vec3_256 ab = b - a;
+        alignas(32) const hml::vec3_256 bc = c - b;
+        alignas(32) const hml::vec3_256 ca = a - c;
+        alignas(32) const hml::vec3_256 cross = hml::cross(ab, c - a);
+        alignas(32) const hml::vec3_256 normal = cross / hml::vec3_256(_mm256_sqrt_ps(hml::dot(cross, cross)));
+        const __m256 height = hml::dot(center - a, normal);
+        alignas(32) const hml::vec3_256 projected = center - normal * hml::vec3_256(height);
+        // On the inner side of every edge
+        const __m256 inside = _mm256_and_ps(
+            _mm256_cmp_ps(hml::dot(hml::cross(ab, projected - a), normal), ZERO, _CMP_GE_OQ), _mm256_and_ps(
+            _mm256_cmp_ps(hml::dot(hml::cross(bc, projected - b), normal), ZERO, _CMP_GE_OQ),
+            _mm256_cmp_ps(hml::dot(hml::cross(ca, projected - c), normal), ZERO, _CMP_GE_OQ)));
+
+        // Otherwise the closest point is on the closest edge
+        __m256 edgeDistance2 = _mm256_set1_ps(std::numeric_limits<float>::max());
+        alignas(32) hml::vec3_256 edgeClosest = a;
+        for (const auto& [edgeBegin, edge] : { std::make_pair(a, ab), std::make_pair(b, bc), std::make_pair(c, ca) }) {
+            const __m256 t = _mm256_min_ps(_mm256_max_ps(
+                _mm256_div_ps(hml::dot(center - edgeBegin, edge), hml::dot(edge, edge)), ZERO), ONE);
+            alignas(32) const hml::vec3_256 closest = edgeBegin + edge * hml::vec3_256(t);
+            alignas(32) const hml::vec3_256 toCenter = center - closest;
+            const __m256 distance2 = hml::dot(toCenter, toCenter);
+            const __m256 closer = _mm256_cmp_ps(distance2, edgeDistance2, _CMP_LT_OQ);
+            edgeDistance2 = _mm256_blendv_ps(edgeDistance2, distance2, closer);
+            edgeClosest = hml::vec3_256(
+                _mm256_blendv_ps(edgeClosest.x, closest.x, closer),
+                _mm256_blendv_ps(edgeClosest.y, closest.y, closer),
+                _mm256_blendv_ps(edgeClosest.z, closest.z, closer));
+        }
+        const __m256 edgeDistance = _mm256_sqrt_ps(edgeDistance2);
+        // Touching an edge exactly from above is as good as being inside
+        const __m256 alongNormal = _mm256_or_ps(inside, _mm256_cmp_ps(edgeDistance, EPSILON, _CMP_LT_OQ));
+        alignas(32) const hml::vec3_256 edgeDir = (center - edgeClosest) / hml::vec3_256(_mm256_max_ps(edgeDistance, EPSILON));
+
+        const __m256 depth = _mm256_blendv_ps(_mm256_sub_ps(radius, edgeDistance), _mm256_sub_ps(radius, height), alongNormal);
+        const __m256 side = _mm256_blendv_ps(
+            _mm256_cmp_ps(height, ZERO, _CMP_GE_OQ),
+            _mm256_cmp_ps(height, negRadius, _CMP_GT_OQ), alongNormal);
+        const int hitLanes = _mm256_movemask_ps(_mm256_and_ps(side, _mm256_cmp_ps(depth, ZERO, _CMP_GT_OQ)))
+            & ((1 << count) - 1);
+        if (hitLanes == 0) return;
+
+        alignas(32) float depths[8], dirXs[8], dirYs[8], dirZs[8];
+        _mm256_store_ps(depths, depth);
+        hml::vec3_256(
+            _mm256_blendv_ps(edgeDir.x, normal.x, alongNormal),
+            _mm256_blendv_ps(edgeDir.y, normal.y, alongNormal),
+            _mm256_blendv_ps(edgeDir.z, normal.z, alongNormal)).store(dirXs, dirYs, dirZs);
+        for (int mask = hitLanes; mask; mask &= mask - 1) {
+            const auto lane = std::countr_zero(static_cast<uint32_t>(mask));
+            if (depths[lane] <= bestDepth) continue;
+            bestDepth = depths[lane];
+            bestDir = glm::vec3{ dirXs[lane], dirYs[lane], dirZs[lane] };
+        }
+    };
+
+    // The first triangle of a batch fills all the lanes, so that the unused
+    // ones of a partial batch hold it and get masked out by (1 << count) - 1
+    size_t lane = 0;
+    const auto pushTriangle = [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        for (size_t i = lane; i < (lane == 0 ? Bodies::LANES : lane + 1); i++) {
+            ax[i] = a.x; ay[i] = a.y; az[i] = a.z;
+            bx[i] = b.x; by[i] = b.y; bz[i] = b.z;
+            cx[i] = c.x; cy[i] = c.y; cz[i] = c.z;
+        }
+        if (++lane == Bodies::LANES) {
+            testTriangles(lane);
+            lane = 0;
+        }
+    };
+    const auto vertex = [&grid](int x, int z) {
+        return glm::vec3{
+            grid.start.x + x * grid.cellSize.x,
+            grid.at(x, z),
+            grid.start.y + z * grid.cellSize.y };
+    };
+    for (int z = range.firstZ; z <= range.lastZ; z++) {
+        for (int x = range.firstX; x <= range.lastX; x++) {
+            // Wound so that the normals point up
+            pushTriangle(vertex(x, z), vertex(x, z + 1), vertex(x + 1, z));
+            pushTriangle(vertex(x + 1, z + 1), vertex(x + 1, z), vertex(x, z + 1));
+        }
+    }
+    if (lane > 0) testTriangles(lane);
+
+    if (bestDepth == 0.0f) return std::nullopt;
+    return { Detection{
+        .dir = bestDir,
+        .extent = bestDepth,
+        .contactPoints = { s.center - bestDir * (s.radius - bestDepth * 0.5f) },
+    }};
+}
+
+
+// The corners under the surface are pushed out along the normal of the
+// triangle they are under; the samples inside the Box (a ridge narrower than
+// it) out of its nearest face. dir is the average, weighed by depth.
+std::optional<HmlPhysics::Detection> HmlPhysics::detectHeightfieldBox(const HeightGrid& grid, const Object::Box& b,
+        const Object::AABB& aabb, const Object::Box::OrientationData& axes, const hml::vec3_256& corners) noexcept {
+    const auto range = grid.cellsUnder(aabb);
+    if (range.empty()) return std::nullopt;
+
+    alignas(32) static const __m256 ZERO = _mm256_setzero_ps();
+    alignas(32) static const __m256 ONE = _mm256_set1_ps(1.0f);
+    alignas(32) static const __m256 SIGN_BIT = _mm256_set1_ps(-0.0f);
+    ContactManifold points;
+    glm::vec3 dirSum{0};
+    float maxDepth = 0.0f;
+    const auto addContact = [&](const glm::vec3& point, const glm::vec3& dir, float depth) {
+        points.add(point);
+        dirSum += dir * depth;
+        maxDepth = std::max(maxDepth, depth);
+    };
+
+    { // The 8 corners, against the heights interpolated like Himmel::World::heightAtCoordWithT()
+        alignas(32) float px[8], py[8], pz[8], txs[8], tzs[8];
+        alignas(32) float h00[8], h10[8], h01[8], h11[8];
+        corners.store(px, py, pz);
+        int validLanes = 0;
+        for (size_t lane = 0; lane < Bodies::LANES; lane++) {
+            const float cellX = (px[lane] - grid.start.x) / grid.cellSize.x;
+            const float cellZ = (pz[lane] - grid.start.y) / grid.cellSize.y;
+            const bool onGrid = cellX >= 0.0f && cellX < static_cast<float>(grid.countX - 1)
+                             && cellZ >= 0.0f && cellZ < static_cast<float>(grid.countZ - 1);
+            if (!onGrid) {
+                txs[lane] = tzs[lane] = h00[lane] = h10[lane] = h01[lane] = h11[lane] = 0.0f;
+                continue;
+            }
+            validLanes |= 1 << lane;
+            const auto x = static_cast<size_t>(cellX);
+            const auto z = static_cast<size_t>(cellZ);
+            txs[lane] = cellX - static_cast<float>(x);
+            tzs[lane] = cellZ - static_cast<float>(z);
+            h00[lane] = grid.at(x, z);     h10[lane] = grid.at(x + 1, z);
+            h01[lane] = grid.at(x, z + 1); h11[lane] = grid.at(x + 1, z + 1);
+        }
+        if (validLanes) {
+            const __m256 tx = _mm256_load_ps(txs);
+            const __m256 tz = _mm256_load_ps(tzs);
+            const __m256 bottomLeft  = _mm256_load_ps(h00);
+            const __m256 bottomRight = _mm256_load_ps(h10);
+            const __m256 topLeft     = _mm256_load_ps(h01);
+            const __m256 topRight    = _mm256_load_ps(h11);
+            // The slopes of the bottom-left and the top-right triangles
+            const __m256 lower = _mm256_cmp_ps(_mm256_add_ps(tx, tz), ONE, _CMP_LT_OQ);
+            const __m256 diffX = _mm256_blendv_ps(_mm256_sub_ps(topRight, topLeft),     _mm256_sub_ps(bottomRight, bottomLeft), lower);
+            const __m256 diffZ = _mm256_blendv_ps(_mm256_sub_ps(topRight, bottomRight), _mm256_sub_ps(topLeft, bottomLeft),     lower);
+            const __m256 surface = _mm256_blendv_ps(
+                _mm256_sub_ps(topRight, _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_sub_ps(ONE, tx), diffX),
+                    _mm256_mul_ps(_mm256_sub_ps(ONE, tz), diffZ))),
+                _mm256_add_ps(bottomLeft, _mm256_add_ps(_mm256_mul_ps(tx, diffX), _mm256_mul_ps(tz, diffZ))),
+                lower);
+            alignas(32) const hml::vec3_256 up(
+                _mm256_xor_ps(_mm256_div_ps(diffX, _mm256_set1_ps(grid.cellSize.x)), SIGN_BIT),
+                ONE,
+                _mm256_xor_ps(_mm256_div_ps(diffZ, _mm256_set1_ps(grid.cellSize.y)), SIGN_BIT));
+            alignas(32) const hml::vec3_256 normal = up / hml::vec3_256(_mm256_sqrt_ps(hml::dot(up, up)));
+            // Perpendicular to the triangle
+            const __m256 depth = _mm256_mul_ps(_mm256_sub_ps(surface, _mm256_load_ps(py)), normal.y);
+            const int hitLanes = _mm256_movemask_ps(_mm256_cmp_ps(depth, ZERO, _CMP_GT_OQ)) & validLanes;
+            if (hitLanes) {
+                alignas(32) float depths[8], nx[8], ny[8], nz[8];
+                _mm256_store_ps(depths, depth);
+                normal.store(nx, ny, nz);
+                for (int mask = hitLanes; mask; mask &= mask - 1) {
+                    const auto lane = std::countr_zero(static_cast<uint32_t>(mask));
+                    const glm::vec3 n{ nx[lane], ny[lane], nz[lane] };
+                    addContact(glm::vec3{ px[lane], py[lane], pz[lane] } + n * (depths[lane] * 0.5f), n, depths[lane]);
+                }
+            }
+        }
+    }
+
+    { // The samples, projected onto the axes of the Box
+        const auto& [iNorm, jNorm, kNorm] = axes;
+        const std::array<glm::vec3, 3> boxAxes = { iNorm, jNorm, kNorm };
+        const auto axis256 = [](const glm::vec3& v) {
+            return hml::vec3_256(_mm256_set1_ps(v.x), _mm256_set1_ps(v.y), _mm256_set1_ps(v.z));
+        };
+        alignas(32) const hml::vec3_256 center = axis256(b.center);
+        alignas(32) const hml::vec3_256 i256 = axis256(iNorm);
+        alignas(32) const hml::vec3_256 j256 = axis256(jNorm);
+        alignas(32) const hml::vec3_256 k256 = axis256(kNorm);
+        const __m256 halfX = _mm256_set1_ps(b.halfDimensions.x);
+        const __m256 halfY = _mm256_set1_ps(b.halfDimensions.y);
+        const __m256 halfZ = _mm256_set1_ps(b.halfDimensions.z);
+
+        alignas(32) float vx[8] = {}, vy[8] = {}, vz[8] = {};
+        size_t count = 0;
+        const auto testSamples = [&]() {
+            alignas(32) const hml::vec3_256 v = hml::vec3_256(vx, vy, vz) - center;
+            alignas(32) const hml::vec3_256 proj(hml::dot(v, i256), hml::dot(v, j256), hml::dot(v, k256));
+            const __m256 inside = _mm256_and_ps(
+                _mm256_cmp_ps(_mm256_andnot_ps(SIGN_BIT, proj.x), halfX, _CMP_LT_OQ), _mm256_and_ps(
+                _mm256_cmp_ps(_mm256_andnot_ps(SIGN_BIT, proj.y), halfY, _CMP_LT_OQ),
+                _mm256_cmp_ps(_mm256_andnot_ps(SIGN_BIT, proj.z), halfZ, _CMP_LT_OQ)));
+            const int hitLanes = _mm256_movemask_ps(inside) & ((1 << count) - 1);
+            if (hitLanes == 0) return;
+
+            alignas(32) float projs[3][8];
+            proj.store(projs[0], projs[1], projs[2]);
+            for (int mask = hitLanes; mask; mask &= mask - 1) {
+                const auto lane = std::countr_zero(static_cast<uint32_t>(mask));
+                // Out of the nearest face, towards the inside of the Box; the
+                // terrain only ever pushes up, so the faces looking up are skipped
+                glm::vec3 dir{0};
+                float depth = std::numeric_limits<float>::max();
+                for (int axis = 0; axis < 3; axis++) {
+                    const auto axisDir = projs[axis][lane] < 0.0f ? boxAxes[axis] : -boxAxes[axis];
+                    const float axisDepth = b.halfDimensions[axis] - std::abs(projs[axis][lane]);
+                    if (axisDir.y <= 0.0f || axisDepth >= depth) continue;
+                    dir = axisDir;
+                    depth = axisDepth;
+                }
+                if (dir.y <= 0.0f) continue;
+                addContact(glm::vec3{ vx[lane], vy[lane], vz[lane] } - dir * (depth * 0.5f), dir, depth);
+            }
+        };
+        for (int z = range.firstZ; z <= range.lastZ + 1; z++) {
+            for (int x = range.firstX; x <= range.lastX + 1; x++) {
+                vx[count] = grid.start.x + x * grid.cellSize.x;
+                vy[count] = grid.at(x, z);
+                vz[count] = grid.start.y + z * grid.cellSize.y;
+                if (++count == Bodies::LANES) {
+                    testSamples();
+                    count = 0;
+                }
+            }
+        }
+        if (count > 0) testSamples();
+    }
+
+    if (points.empty()) return std::nullopt;
+    return { Detection{
+        .dir = glm::normalize(dirSum),
+        .extent = maxDepth,
+        .contactPoints = points,
+    }};
+}
+// ============================================================================
+// ===================== Queries ==============================================
+// ============================================================================
+void HmlPhysics::raycast(std::span<const Ray> rays, std::span<RayHit> hits) const noexcept {
+    assert(hits.size() >= rays.size() && "Not enough room for the hits");
+    const auto snapshot = latestQuerySnapshot.load();
+    if (!snapshot) {
+        std::fill_n(hits.begin(), rays.size(), RayHit{});
+        return;
+    }
+    snapshot->raycast(rays, hits);
+}
+
+
+void HmlPhysics::overlap(std::span<const Object> shapes, std::vector<OverlapHit>& hits) const noexcept {
+    const auto snapshot = latestQuerySnapshot.load();
+    if (snapshot) snapshot->overlap(shapes, hits);
+}
+
+
+void HmlPhysics::publishQuerySnapshot() noexcept {
+    // The Grid broadphase has already brought bucketTable up to date during the step
+    if (broadphase != Broadphase::Grid) reassignBuckets();
+
+    // Reuse a snapshot that neither the readers nor latestQuerySnapshot hold anymore
+    std::shared_ptr<QuerySnapshot> snapshot;
+    for (const auto& pooled : querySnapshots) {
+        if (pooled.use_count() == 1) {
+            // use_count() is a relaxed load, so on its own it does not order the
+            // last reader's reads before our writes; the fence pairs with the
+            // release of the reader dropping its reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+            snapshot = pooled;
+            break;
+        }
+    }
+    if (!snapshot) snapshot = querySnapshots.emplace_back(std::make_shared<QuerySnapshot>());
+    auto& s = *snapshot;
+
+    const size_t count = objects.size();
+    s.ids.resize(count);
+    s.types.resize(count);
+    s.orientations.resize(count);
+    for (auto* v : { &s.centerXs, &s.centerYs, &s.centerZs, &s.halfXs, &s.halfYs, &s.halfZs }) v->resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const auto& object = objects[i];
+        s.ids[i] = object.id;
+        s.types[i] = object.type;
+        s.orientations[i] = object.orientation;
+        s.centerXs[i] = object.position.x;
+        s.centerYs[i] = object.position.y;
+        s.centerZs[i] = object.position.z;
+        if (object.isSphere()) {
+            s.halfXs[i] = s.halfYs[i] = s.halfZs[i] = object.asSphere().radius;
+        } else if (object.isBox()) {
+            const auto& halfDimensions = object.asBox().halfDimensions;
+            s.halfXs[i] = halfDimensions.x;
+            s.halfYs[i] = halfDimensions.y;
+            s.halfZs[i] = halfDimensions.z;
+        } else { // a Heightfield is in no Bucket, so it is never a candidate
+            s.halfXs[i] = s.halfYs[i] = s.halfZs[i] = 0.0f;
+        }
+    }
+
+    // Only the non-empty slots are copied, into a table at most half full
+    s.slots.assign(std::bit_ceil(std::max(bucketTable.nonEmptySlotCount * 2, size_t{16})), BucketTable::Slot{});
+    const auto mask = s.slots.size() - 1;
+    s.levels = gridLevels;
+    s.boundsOfLevel.fill(Object::AABB{
+        .begin = glm::vec3{ std::numeric_limits<float>::max() },
+        .end   = glm::vec3{ std::numeric_limits<float>::lowest() },
+    });
+    for (const auto slotIndex : bucketTable.usedSlots) {
+        const auto& slot = bucketTable.slots[slotIndex];
+        if (slot.count == 0) continue;
+        auto index = BucketTable::firstSlotIndex(slot.key, mask);
+        while (s.slots[index].key != BucketTable::EMPTY_KEY) index = (index + 1) & mask;
+        s.slots[index] = slot;
+        const float cellSize = gridLevels.cellSize(slot.bucket.level);
+        const glm::vec3 bucket{ slot.bucket.x, slot.bucket.y, slot.bucket.z };
+        auto& bounds = s.boundsOfLevel[slot.bucket.level];
+        bounds.begin = glm::min(bounds.begin, bucket * cellSize);
+        bounds.end = glm::max(bounds.end, (bucket + 1.0f) * cellSize);
+    }
+    s.objectIndices = bucketTable.objectIndices;
+
+    latestQuerySnapshot.store(std::move(snapshot));
+}
+
+
+const HmlPhysics::BucketTable::Slot* HmlPhysics::QuerySnapshot::findSlot(const Bucket& bucket) const noexcept {
+    const auto key = bucket.packed();
+    const auto mask = slots.size() - 1;
+    for (auto index = BucketTable::firstSlotIndex(key, mask);; index = (index + 1) & mask) {
+        const auto& slot = slots[index];
+        if (slot.key == key) return &slot;
+        if (slot.key == BucketTable::EMPTY_KEY) return nullptr;
+    }
+}
+
+
+HmlPhysics::Object HmlPhysics::QuerySnapshot::objectAt(uint32_t objectIndex) const noexcept {
+    Object object(types[objectIndex]);
+    object.position = glm::vec3{ centerXs[objectIndex], centerYs[objectIndex], centerZs[objectIndex] };
+    if (object.isSphere()) {
+        object.asSphere().radius = halfXs[objectIndex];
+    } else {
+        object.asBox().halfDimensions = glm::vec3{ halfXs[objectIndex], halfYs[objectIndex], halfZs[objectIndex] };
+    }
+    object.orientation = orientations[objectIndex];
+    object.id = ids[objectIndex];
+    return object;
+}
+
+
+template<typename F>
+void HmlPhysics::QuerySnapshot::forEachSlotAlong(const Ray& ray, const F& func) const noexcept {
+    for (Bucket::Level level = 0; level < levels.count; level++) {
+        forEachSlotAlong(ray, level, func);
+    }
+}
+
+
+template<typename F>
+void HmlPhysics::QuerySnapshot::forEachSlotAlong(const Ray& ray, Bucket::Level level, const F& func) const noexcept {
+    // Clip the ray to the used Buckets of the level (none if it is empty)
+    const auto& bounds = boundsOfLevel[level];
+    float tEnter = 0.0f;
+    float tExit = ray.maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        const float invDir = 1.0f / ray.dir[axis];
+        float t1 = (bounds.begin[axis] - ray.origin[axis]) * invDir;
+        float t2 = (bounds.end[axis]   - ray.origin[axis]) * invDir;
+        if (t1 > t2) std::swap(t1, t2);
+        tEnter = std::max(tEnter, t1);
+        tExit = std::min(tExit, t2);
+    }
+    if (!(tEnter <= tExit)) return;
+
+    // Amanatides & Woo: tMax is where the ray crosses into the next Bucket along
+    // each axis and tDelta how far apart those crossings are
+    const float cellSize = levels.cellSize(level);
+    Bucket bucket = levels.bucketAt(ray.origin + ray.dir * tEnter, level);
+    const std::array<Bucket::Coord*, 3> coords = { &bucket.x, &bucket.y, &bucket.z };
+    std::array<Bucket::Coord, 3> steps = { 0, 0, 0 };
+    glm::vec3 tMax{ std::numeric_limits<float>::infinity() };
+    glm::vec3 tDelta{ std::numeric_limits<float>::infinity() };
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.dir[axis] == 0.0f) continue;
+        steps[axis] = ray.dir[axis] > 0.0f ? 1 : -1;
+        const float boundary = (*coords[axis] + (ray.dir[axis] > 0.0f ? 1.0f : 0.0f)) * cellSize;
+        tMax[axis] = (boundary - ray.origin[axis]) / ray.dir[axis];
+        tDelta[axis] = cellSize / std::abs(ray.dir[axis]);
+    }
+
+    // Every crossing moves along one axis, so a ray can't cross more Buckets than this
+    const glm::vec3 boundsSize = (bounds.end - bounds.begin) / cellSize;
+    const int maxCrossings = static_cast<int>(boundsSize.x + boundsSize.y + boundsSize.z) + 3;
+    for (int crossing = 0; crossing < maxCrossings; crossing++) {
+        if (const auto* slot = findSlot(bucket)) func(*slot);
+        const int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        if (tMax[axis] > tExit) break;
+        *coords[axis] += steps[axis];
+        tMax[axis] += tDelta[axis];
+    }
+}
+
+
+void HmlPhysics::QuerySnapshot::raycast(std::span<const Ray> rays, std::span<RayHit> hits) const noexcept {
+    assert(hits.size() >= rays.size() && "Not enough room for the hits");
+    // The rays are tested in packets; each Object near any ray of the packet
+    // is a candidate for all of them, but only once
+    std::vector<uint32_t> stampOfObject(size(), 0);
+    std::vector<uint32_t> candidates;
+    for (size_t begin = 0; begin < rays.size(); begin += Bodies::LANES) {
+        const size_t count = std::min(Bodies::LANES, rays.size() - begin);
+        const auto stamp = static_cast<uint32_t>(begin / Bodies::LANES + 1);
+        candidates.clear();
+        for (size_t i = begin; i < begin + count; i++) {
+            forEachSlotAlong(rays[i], [&](const BucketTable::Slot& slot) {
+                for (const auto objectIndex : std::span<const uint32_t>(objectIndices.data() + slot.begin, slot.count)) {
+                    if (stampOfObject[objectIndex] == stamp) continue;
+                    stampOfObject[objectIndex] = stamp;
+                    candidates.push_back(objectIndex);
+                }
+            });
+        }
+        raycastPacket(rays.subspan(begin, count), hits.subspan(begin, count), candidates);
+    }
+}
+
+
+void HmlPhysics::QuerySnapshot::raycastPacket(std::span<const Ray> rays, std::span<RayHit> hits, std::span<const uint32_t> candidates) const noexcept {
+    assert(rays.size() <= Bodies::LANES && "Too many rays for a packet");
+    alignas(32) static const __m256 ZERO = _mm256_setzero_ps();
+    alignas(32) static const __m256 ONE = _mm256_set1_ps(1.0f);
+    alignas(32) static const __m256 INF = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    alignas(32) static const __m256 SIGN_BIT = _mm256_set1_ps(-0.0f);
+    // The unused lanes can't hit anything, as nothing is closer than -1
+    alignas(32) float ox[8] = {}, oy[8] = {}, oz[8] = {};
+    alignas(32) float dx[8], dy[8] = {}, dz[8] = {};
+    alignas(32) float distances[8];
+    alignas(32) int32_t indices[8];
+    for (size_t lane = 0; lane < Bodies::LANES; lane++) {
+        dx[lane] = 1.0f;
+        distances[lane] = -1.0f;
+    }
+    for (size_t lane = 0; lane < rays.size(); lane++) {
+        const auto& ray = rays[lane];
+        ox[lane] = ray.origin.x; oy[lane] = ray.origin.y; oz[lane] = ray.origin.z;
+        dx[lane] = ray.dir.x;    dy[lane] = ray.dir.y;    dz[lane] = ray.dir.z;
+        distances[lane] = ray.maxDistance;
+    }
+    alignas(32) const hml::vec3_256 origin(ox, oy, oz);
+    alignas(32) const hml::vec3_256 dir(dx, dy, dz);
+    __m256 best = _mm256_load_ps(distances);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+
+    for (const auto objectIndex : candidates) {
+        alignas(32) const hml::vec3_256 m = origin - hml::vec3_256(
+            _mm256_set1_ps(centerXs[objectIndex]),
+            _mm256_set1_ps(centerYs[objectIndex]),
+            _mm256_set1_ps(centerZs[objectIndex]));
+        __m256 t;
+        __m256 hit;
+        if (types[objectIndex] == Object::Type::Sphere) {
+            // |m + t * dir| == radius, with |dir| == 1; the entry point, unless the ray starts inside
+            const float radius = halfXs[objectIndex];
+            const __m256 b = hml::dot(m, dir);
+            const __m256 c = _mm256_sub_ps(hml::dot(m, m), _mm256_set1_ps(radius * radius));
+            const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+            const __m256 root = _mm256_sqrt_ps(_mm256_max_ps(discriminant, ZERO));
+            t = _mm256_max_ps(_mm256_sub_ps(ZERO, _mm256_add_ps(b, root)), ZERO);
+            hit = _mm256_and_ps(
+                _mm256_cmp_ps(discriminant, ZERO, _CMP_GE_OQ),
+                _mm256_cmp_ps(_mm256_sub_ps(root, b), ZERO, _CMP_GE_OQ));
+        } else {
+            // The slabs between the opposite faces, in the frame of the Box
+            const glm::mat3 axes = glm::mat3_cast(glm::normalize(orientations[objectIndex]));
+            const std::array<float, 3> halves = { halfXs[objectIndex], halfYs[objectIndex], halfZs[objectIndex] };
+            __m256 tNear = ZERO;
+            __m256 tFar = INF;
+            for (int axis = 0; axis < 3; axis++) {
+                alignas(32) const hml::vec3_256 u(
+                    _mm256_set1_ps(axes[axis].x),
+                    _mm256_set1_ps(axes[axis].y),
+                    _mm256_set1_ps(axes[axis].z));
+                const __m256 localOrigin = hml::dot(m, u);
+                const __m256 invDir = _mm256_div_ps(ONE, hml::dot(dir, u));
+                const __m256 half = _mm256_set1_ps(halves[axis]);
+                const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_xor_ps(half, SIGN_BIT), localOrigin), invDir);
+                const __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(half, localOrigin), invDir);
+                tNear = _mm256_max_ps(tNear, _mm256_min_ps(t1, t2));
+                tFar = _mm256_min_ps(tFar, _mm256_max_ps(t1, t2));
+            }
+            t = tNear;
+            hit = _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ);
+        }
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+        best = _mm256_blendv_ps(best, t, hit);
+        bestIndex = _mm256_castps_si256(_mm256_blendv_ps(
+            _mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int32_t>(objectIndex))), hit));
+    }
+    _mm256_store_ps(distances, best);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(indices), bestIndex);
+
+    // Only the hits need the normal, so that is left to the scalar code
+    for (size_t lane = 0; lane < rays.size(); lane++) {
+        if (indices[lane] < 0) {
+            hits[lane] = RayHit{};
+            continue;
+        }
+        const auto objectIndex = static_cast<uint32_t>(indices[lane]);
+        const auto& ray = rays[lane];
+        const glm::vec3 center{ centerXs[objectIndex], centerYs[objectIndex], centerZs[objectIndex] };
+        const glm::vec3 point = ray.origin + ray.dir * distances[lane];
+        glm::vec3 normal = -ray.dir; // if the ray starts inside
+        if (distances[lane] > 0.0f) {
+            if (types[objectIndex] == Object::Type::Sphere) {
+                normal = glm::normalize(point - center);
+            } else {
+                // The face the point is on is along the axis it is relatively the farthest out
+                const glm::mat3 axes = glm::mat3_cast(glm::normalize(orientations[objectIndex]));
+                const std::array<float, 3> halves = { halfXs[objectIndex], halfYs[objectIndex], halfZs[objectIndex] };
+                int faceAxis = 0;
+                float faceProj = 0.0f;
+                float faceRatio = -1.0f;
+                for (int axis = 0; axis < 3; axis++) {
+                    const float proj = glm::dot(point - center, axes[axis]);
+                    const float ratio = std::abs(proj) / halves[axis];
+                    if (ratio > faceRatio) {
+                        faceAxis = axis;
+                        faceProj = proj;
+                        faceRatio = ratio;
+                    }
+                }
+                normal = faceProj < 0.0f ? -axes[faceAxis] : axes[faceAxis];
+            }
+        }
+        hits[lane] = RayHit{ .id = ids[objectIndex], .distance = distances[lane], .normal = normal };
+    }
+}
+
+
+void HmlPhysics::QuerySnapshot::overlap(std::span<const Object> shapes, std::vector<OverlapHit>& hits) const noexcept {
+    std::vector<uint32_t> stampOfObject(size(), 0);
+    for (uint32_t shapeIndex = 0; shapeIndex < shapes.size(); shapeIndex++) {
+        const auto& shape = shapes[shapeIndex];
+        const auto aabb = shape.aabb();
+        const auto stamp = shapeIndex + 1;
+        for (Bucket::Level level = 0; level < levels.count; level++) {
+            // Only the used Buckets can hold anything
+            const auto& bounds = boundsOfLevel[level];
+            if (!aabb.intersects(bounds)) continue;
+            const auto first = levels.bucketAt(glm::max(aabb.begin, bounds.begin), level);
+            const auto last = levels.bucketAt(glm::min(aabb.end, bounds.end), level);
+            for (int x = first.x; x <= last.x; x++) {
+                for (int y = first.y; y <= last.y; y++) {
+                    for (int z = first.z; z <= last.z; z++) {
+                        const auto* slot = findSlot(Bucket{
+                            .x = static_cast<Bucket::Coord>(x),
+                            .y = static_cast<Bucket::Coord>(y),
+                            .z = static_cast<Bucket::Coord>(z),
+                            .level = level });
+                        if (!slot) continue;
+                        for (const auto objectIndex : std::span<const uint32_t>(objectIndices.data() + slot->begin, slot->count)) {
+                            if (stampOfObject[objectIndex] == stamp) continue;
+                            stampOfObject[objectIndex] = stamp;
+                            const auto other = objectAt(objectIndex);
+                            const bool overlaps = shape.isSphere()
+                                ? (other.isSphere() ? detect(shape.asSphere(), other.asSphere()) : detect(shape.asSphere(), other.asBox())).has_value()
+                                : (other.isSphere() ? detect(shape.asBox(),    other.asSphere()) : detect(shape.asBox(),    other.asBox())).has_value();
+                            if (overlaps) hits.push_back(OverlapHit{ .shapeIndex = shapeIndex, .id = ids[objectIndex] });
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+// ============================================================================
+// ===================== Integration ==========================================
+// ============================================================================
+void HmlPhysics::integrate(float dt) noexcept {
+    constexpr size_t BODIES_PER_TASK = 32 * Bodies::LANES;
+    const size_t taskCount = (bodies.paddedSize() + BODIES_PER_TASK - 1) / BODIES_PER_TASK;
+    workerEvents.resize(workerCount());
+    for (auto& events : workerEvents) events.fastBodies.clear();
+    runTasks(taskCount, [&](size_t task, size_t worker) {
+        const size_t end = std::min((task + 1) * BODIES_PER_TASK, bodies.paddedSize());
+        integrateBodies(dt, task * BODIES_PER_TASK, end, workerEvents[worker].fastBodies);
+    });
+
+    // NOTE The sweeps see the Bodies moved by the earlier ones, so their order must not depend on the scheduling
+    fastBodies.clear();
+    for (const auto& events : workerEvents) fastBodies.insert(fastBodies.end(), events.fastBodies.begin(), events.fastBodies.end());
+    std::sort(fastBodies.begin(), fastBodies.end(), [](const FastBody& a, const FastBody& b) { return a.bodyIndex < b.bodyIndex; });
+}
+
+
+void HmlPhysics::integrateBodies(float dt, size_t begin, size_t end, std::vector<FastBody>& fast) noexcept {
+    assert(begin % Bodies::LANES == 0 && end % Bodies::LANES == 0 && "Unaligned range of bodies to integrate");
+
+    alignas(32) const hml::vec3_256 dts(_mm256_set1_ps(dt));
+    // NOTE F = gravity, so no need for * invMass
+    alignas(32) const hml::vec3_256 gravityDt(
+        _mm256_set1_ps(dt * gravity.x),
+        _mm256_set1_ps(dt * gravity.y),
+        _mm256_set1_ps(dt * gravity.z));
+    alignas(32) static const __m256 ONE = _mm256_set1_ps(1.0f);
+    alignas(32) static const __m256 TWO = _mm256_set1_ps(2.0f);
+    const __m256 dt2 = _mm256_set1_ps(dt * dt);
+    const __m256 ccdMotionFraction = _mm256_set1_ps(CCD_MOTION_FRACTION);
+
+    auto& b = bodies;
+    for (size_t i = begin; i < end; i += Bodies::LANES) {
+        // NOTE Sleeping bodies are at rest, so only gravity needs to be kept away from them
+        const __m256 awakeMask = _mm256_load_ps(&b.awakeMasks[i]);
+        const int awakeLanes = _mm256_movemask_ps(awakeMask);
+        if (awakeLanes == 0) continue;
+
+        alignas(32) hml::vec3_256 position(&b.positionXs[i], &b.positionYs[i], &b.positionZs[i]);
+        alignas(32) hml::vec3_256 velocity(&b.velocityXs[i], &b.velocityYs[i], &b.velocityZs[i]);
+        alignas(32) const hml::vec3_256 angularMomentum(&b.angularMomentumXs[i], &b.angularMomentumYs[i], &b.angularMomentumZs[i]);
+        alignas(32) const hml::vec3_256 invInertia(&b.invInertiaXs[i], &b.invInertiaYs[i], &b.invInertiaZs[i]);
+        const __m256 qw = _mm256_load_ps(&b.orientationWs[i]);
+        alignas(32) const hml::vec3_256 qv(&b.orientationXs[i], &b.orientationYs[i], &b.orientationZs[i]);
+
+        // Bodies that move too far for the discrete tests get swept afterwards
+        const __m256 motionLimit = _mm256_mul_ps(_mm256_load_ps(&b.sweptRadii[i]), ccdMotionFraction);
+        const __m256 motion2 = _mm256_mul_ps(hml::dot(velocity, velocity), dt2);
+        int fastLanes = _mm256_movemask_ps(_mm256_cmp_ps(motion2, _mm256_mul_ps(motionLimit, motionLimit), _CMP_GT_OQ)) & awakeLanes;
+        while (fastLanes) {
+            const int lane = std::countr_zero(static_cast<unsigned int>(fastLanes));
+            fastLanes &= fastLanes - 1;
+            fast.push_back(FastBody{
+                .bodyIndex = static_cast<Object::BodyIndex>(i + lane),
+                .startPosition = glm::vec3{ b.positionXs[i + lane], b.positionYs[i + lane], b.positionZs[i + lane] },
+            });
+        }
+
+        position = position + velocity * dts;
+        velocity = velocity + hml::vec3_256(
+            _mm256_and_ps(gravityDt.x, awakeMask),
+            _mm256_and_ps(gravityDt.y, awakeMask),
+            _mm256_and_ps(gravityDt.z, awakeMask));
+
+        // Columns of the rotation matrix (the transpose of what quatToMat3() returns)
+        const __m256 xx = _mm256_mul_ps(qv.x, qv.x);
+        const __m256 yy = _mm256_mul_ps(qv.y, qv.y);
+        const __m256 zz = _mm256_mul_ps(qv.z, qv.z);
+        const __m256 xy = _mm256_mul_ps(qv.x, qv.y);
+        const __m256 xz = _mm256_mul_ps(qv.x, qv.z);
+        const __m256 yz = _mm256_mul_ps(qv.y, qv.z);
+        const __m256 wx = _mm256_mul_ps(qw,   qv.x);
+        const __m256 wy = _mm256_mul_ps(qw,   qv.y);
+        const __m256 wz = _mm256_mul_ps(qw,   qv.z);
+        alignas(32) const hml::vec3_256 c0(
+            _mm256_sub_ps(ONE, _mm256_mul_ps(TWO, _mm256_add_ps(yy, zz))),
+            _mm256_mul_ps(TWO, _mm256_add_ps(xy, wz)),
+            _mm256_mul_ps(TWO, _mm256_sub_ps(xz, wy)));
+        alignas(32) const hml::vec3_256 c1(
+            _mm256_mul_ps(TWO, _mm256_sub_ps(xy, wz)),
+            _mm256_sub_ps(ONE, _mm256_mul_ps(TWO, _mm256_add_ps(xx, zz))),
+            _mm256_mul_ps(TWO, _mm256_add_ps(yz, wx)));
+        alignas(32) const hml::vec3_256 c2(
+            _mm256_mul_ps(TWO, _mm256_add_ps(xz, wy)),
+            _mm256_mul_ps(TWO, _mm256_sub_ps(yz, wx)),
+            _mm256_sub_ps(ONE, _mm256_mul_ps(TWO, _mm256_add_ps(xx, yy))));
+
+        // World-space inverse inertia tensor: quatToMat3(q) * invI * quatToMat3(conjugate(q))
+        const __m256 iXX = hml::dot(c0, invInertia * c0);
+        const __m256 iXY = hml::dot(c0, invInertia * c1);
+        const __m256 iXZ = hml::dot(c0, invInertia * c2);
+        const __m256 iYY = hml::dot(c1, invInertia * c1);
+        const __m256 iYZ = hml::dot(c1, invInertia * c2);
+        const __m256 iZZ = hml::dot(c2, invInertia * c2);
+        alignas(32) const hml::vec3_256 angularVelocity(
+            hml::dot(hml::vec3_256(iXX, iXY, iXZ), angularMomentum),
+            hml::dot(hml::vec3_256(iXY, iYY, iYZ), angularMomentum),
+            hml::dot(hml::vec3_256(iXZ, iYZ, iZZ), angularMomentum));
+
+        // orientation += dt * cross(quat(0, angularVelocity), orientation)
+        const __m256 dqw = _mm256_sub_ps(_mm256_setzero_ps(), hml::dot(angularVelocity, qv));
+        alignas(32) const hml::vec3_256 dqv = angularVelocity * hml::vec3_256(qw) + hml::cross(angularVelocity, qv);
+        __m256 newQw = _mm256_add_ps(qw, _mm256_mul_ps(dts.x, dqw));
+        alignas(32) hml::vec3_256 newQv = qv + dts * dqv;
+
+        // NOTE can be done not every step, but this is too trivial so we don't bother
+        const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(newQw, newQw), hml::dot(newQv, newQv)));
+        newQw = _mm256_div_ps(newQw, length);
+        newQv = newQv / hml::vec3_256(length);
+
+        position.store(&b.positionXs[i], &b.positionYs[i], &b.positionZs[i]);
+        velocity.store(&b.velocityXs[i], &b.velocityYs[i], &b.velocityZs[i]);
+        _mm256_store_ps(&b.orientationWs[i], newQw);
+        newQv.store(&b.orientationXs[i], &b.orientationYs[i], &b.orientationZs[i]);
+        _mm256_store_ps(&b.invInertiaWorldXXs[i], iXX);
+        _mm256_store_ps(&b.invInertiaWorldXYs[i], iXY);
+        _mm256_store_ps(&b.invInertiaWorldXZs[i], iXZ);
+        _mm256_store_ps(&b.invInertiaWorldYYs[i], iYY);
+        _mm256_store_ps(&b.invInertiaWorldYZs[i], iYZ);
+        _mm256_store_ps(&b.invInertiaWorldZZs[i], iZZ);
+
+        // Write back what the rest of the pipeline reads through the Object
+        const size_t count = std::min(Bodies::LANES, b.size() - std::min(i, b.size()));
+        for (size_t lane = 0; lane < count; lane++) {
+            if (!(awakeLanes & (1 << lane))) continue;
+            auto& object = objects[b.objectIndices[i + lane]];
+            object.position = glm::vec3{ b.positionXs[i + lane], b.positionYs[i + lane], b.positionZs[i + lane] };
+            object.orientation = glm::quat{ b.orientationWs[i + lane], b.orientationXs[i + lane], b.orientationYs[i + lane], b.orientationZs[i + lane] };
+        }
+    }
+}
+
+
+const std::array<HmlPhysics::Bodies::Array HmlPhysics::Bodies::*, 24> HmlPhysics::Bodies::ALL_ARRAYS{
+    &Bodies::positionXs, &Bodies::positionYs, &Bodies::positionZs,
+    &Bodies::velocityXs, &Bodies::velocityYs, &Bodies::velocityZs,
+    &Bodies::orientationWs, &Bodies::orientationXs, &Bodies::orientationYs, &Bodies::orientationZs,
+    &Bodies::angularMomentumXs, &Bodies::angularMomentumYs, &Bodies::angularMomentumZs,
+    &Bodies::invInertiaXs, &Bodies::invInertiaYs, &Bodies::invInertiaZs,
+    &Bodies::invInertiaWorldXXs, &Bodies::invInertiaWorldXYs, &Bodies::invInertiaWorldXZs,
+    &Bodies::invInertiaWorldYYs, &Bodies::invInertiaWorldYZs, &Bodies::invInertiaWorldZZs,
+    &Bodies::sweptRadii,
+    &Bodies::awakeMasks,
+};
+
+
+HmlPhysics::Object::BodyIndex HmlPhysics::Bodies::push(const Object& object, size_t objectIndex) noexcept {
+    assert(!object.isStationary() && "Stationary Objects do not have a Body");
+    const size_t i = size();
+    if (i == paddedSize()) {
+        // Pad with zeros (and an identity orientation) up to the next multiple of LANES
+        for (auto array : ALL_ARRAYS) (this->*array).resize(i + LANES, 0.0f);
+        std::fill(orientationWs.begin() + i, orientationWs.end(), 1.0f);
+    }
+
+    const auto& dp = *object.dynamicProperties;
+    const auto& invI = dp.invRotationalInertiaTensor;
+    assert(invI[0][1] == 0.0f && invI[0][2] == 0.0f && invI[1][0] == 0.0f &&
+           invI[1][2] == 0.0f && invI[2][0] == 0.0f && invI[2][1] == 0.0f &&
+           "Only diagonal inertia tensors are supported by Bodies");
+    positionXs[i] = object.position.x;
+    positionYs[i] = object.position.y;
+    positionZs[i] = object.position.z;
+    velocityXs[i] = dp.velocity.x;
+    velocityYs[i] = dp.velocity.y;
+    velocityZs[i] = dp.velocity.z;
+    orientationWs[i] = object.orientation.w;
+    orientationXs[i] = object.orientation.x;
+    orientationYs[i] = object.orientation.y;
+    orientationZs[i] = object.orientation.z;
+    angularMomentumXs[i] = dp.angularMomentum.x;
+    angularMomentumYs[i] = dp.angularMomentum.y;
+    angularMomentumZs[i] = dp.angularMomentum.z;
+    invInertiaXs[i] = invI[0][0];
+    invInertiaYs[i] = invI[1][1];
+    invInertiaZs[i] = invI[2][2];
+    sweptRadii[i] = object.isSphere() ? object.asSphere().radius : std::min(object.asBox().halfDimensions);
+    setAwake(i, true);
+    sleepCounters.push_back(0);
+    objectIndices.push_back(objectIndex);
+
+    return static_cast<Object::BodyIndex>(i);
+}
+
+
+void HmlPhysics::Bodies::remove(size_t i) noexcept {
+    const size_t last = size() - 1;
+    for (auto array : ALL_ARRAYS) {
+        auto& values = this->*array;
+        values[i] = values[last];
+        values[last] = 0.0f; // back to padding (which is also asleep)
+    }
+    orientationWs[last] = 1.0f;
+    sleepCounters[i] = sleepCounters[last];
+    sleepCounters.pop_back();
+    objectIndices[i] = objectIndices[last];
+    objectIndices.pop_back();
+
+    if (size() % LANES == 0) {
+        for (auto array : ALL_ARRAYS) (this->*array).resize(size());
+    }
+}
+// ============================================================================
+// ========================== Shapes ==========================================
+// ============================================================================
+void HmlPhysics::updateShapes() noexcept {
+    constexpr size_t BODIES_PER_TASK = 256;
+    const size_t taskCount = (bodies.size() + BODIES_PER_TASK - 1) / BODIES_PER_TASK;
+    for (auto& events : workerEvents) events.bucketMoves.clear();
+    runTasks(taskCount, [this](size_t task, size_t worker) {
+        auto& bucketMoves = workerEvents[worker].bucketMoves;
+        const size_t end = std::min((task + 1) * BODIES_PER_TASK, bodies.size());
+        for (size_t bodyIndex = task * BODIES_PER_TASK; bodyIndex < end; bodyIndex++) {
+            if (!bodies.isAwake(bodyIndex)) continue; // has not moved
+            const auto objectIndex = bodies.objectIndices[bodyIndex];
+            shapes.update(objectIndex, objects[objectIndex]);
+            const auto bounding = boundingBucketsForAabb(shapes.aabbs[objectIndex]);
+            if (bounding != allBoundingBuckets[objectIndex]) {
+                bucketMoves.push_back(BucketMove{ .bodyIndex = static_cast<Object::BodyIndex>(bodyIndex), .bounding = bounding });
+            }
+        }
+    });
+}
+
+
+void HmlPhysics::Shapes::push(const Object& object) noexcept {
+    const size_t objectIndex = axes.size();
+    for (auto array : { &cornerXs, &cornerYs, &cornerZs }) array->resize(array->size() + Bodies::LANES);
+    axes.emplace_back();
+    aabbs.emplace_back();
+    update(objectIndex, object);
+}
+
+
+void HmlPhysics::Shapes::remove(size_t objectIndex) noexcept {
+    const size_t lastIndex = axes.size() - 1;
+    for (auto array : { &cornerXs, &cornerYs, &cornerZs }) {
+        std::copy_n(array->begin() + lastIndex * Bodies::LANES, Bodies::LANES, array->begin() + objectIndex * Bodies::LANES);
+        array->resize(lastIndex * Bodies::LANES);
+    }
+    axes[objectIndex] = axes[lastIndex];
+    axes.pop_back();
+    aabbs[objectIndex] = aabbs[lastIndex];
+    aabbs.pop_back();
+}
+
+
+void HmlPhysics::Shapes::update(size_t objectIndex, const Object& object) noexcept {
+    const auto rotation = glm::mat3_cast(glm::normalize(object.orientation));
+    axes[objectIndex] = Object::Box::OrientationData{ .i = rotation[0], .j = rotation[1], .k = rotation[2] };
+    const size_t offset = objectIndex * Bodies::LANES;
+    if (!object.isBox()) {
+        std::fill_n(cornerXs.begin() + offset, Bodies::LANES, object.position.x);
+        std::fill_n(cornerYs.begin() + offset, Bodies::LANES, object.position.y);
+        std::fill_n(cornerZs.begin() + offset, Bodies::LANES, object.position.z);
+        aabbs[objectIndex] = object.isSphere() ? object.asSphere().aabb() : Object::AABB{
+            .begin = glm::vec3{ std::numeric_limits<float>::max() },
+            .end   = glm::vec3{ std::numeric_limits<float>::lowest() },
+        }; // Heightfields stay out of the broadphase
+        return;
+    }
+
+    const auto& box = object.asBox();
+    const auto i = rotation[0] * box.halfDimensions.x;
+    const auto j = rotation[1] * box.halfDimensions.y;
+    const auto k = rotation[2] * box.halfDimensions.z;
+    size_t corner = offset;
+    for (float a = -1; a <= 1; a += 2) {
+        for (float b = -1; b <= 1; b += 2) {
+            for (float c = -1; c <= 1; c += 2) {
+                const auto p = (a * i + b * j + c * k) + box.center;
+                cornerXs[corner] = p.x;
+                cornerYs[corner] = p.y;
+                cornerZs[corner] = p.z;
+                corner++;
+            }
+        }
+    }
+    // The same as the extremes of the corners
+    const auto reach = glm::abs(i) + glm::abs(j) + glm::abs(k);
+    aabbs[objectIndex] = Object::AABB{
+        .begin = box.center - reach,
+        .end   = box.center + reach,
+    };
+}
+
+
+void HmlPhysics::Shapes::cornersAt(size_t objectIndex, float* ptr) const noexcept {
+    const size_t offset = objectIndex * Bodies::LANES;
+    for (size_t corner = 0; corner < Bodies::LANES; corner++) {
+        ptr[3 * corner + 0] = cornerXs[offset + corner];
+        ptr[3 * corner + 1] = cornerYs[offset + corner];
+        ptr[3 * corner + 2] = cornerZs[offset + corner];
+    }
+}
+// ============================================================================
+// =================== Register/remove/get ====================================
+// ============================================================================
+void HmlPhysics::internalRegisterObject(const Object& object) noexcept {
+    const size_t objectIndex = objects.size();
+    // NOTE Gets into bucketTable during the next rebuild. The queries use the
+    // Bucket grid whichever the broadphase is.
+    shapes.push(object);
+    const auto& aabb = shapes.aabbs[objectIndex];
+    allBoundingBuckets.push_back(boundingBucketsForAabb(aabb));
+    if (object.isStationary()) bucketTable.addStatic(objectIndex);
+    switch (broadphase) {
+        case Broadphase::Grid:
+            break;
+        case Broadphase::SweepAndPrune:
+            sweepAndPrune.insert(objectIndex, aabb, object.isStationary());
+            break;
+        case Broadphase::AabbTree:
+            treeLeafOfObject.push_back(object.isStationary()
+                ? staticTree.insert(objectIndex, aabb)
+                : dynamicTree.insert(objectIndex, AabbTree::fatten(aabb)));
+            break;
+        default: assert(false && "Unhandled Broadphase");
+    }
+
+    setObjectIndexOf(object.id, objectIndex);
+    objects.push_back(object);
+    if (!object.isStationary()) {
+        objects.back().bodyIndex = bodies.push(object, objectIndex);
+        // The index may have been of a removed Body, whose entries are still in bucketTable
+        bucketTable.movedBodies.push_back(objects.back().bodyIndex);
     }
 }
 
 
-void HmlPhysics::step(float dt) noexcept {
-    auto boundingBoundsBeforeIt = allBoundingBucketsBefore.begin();
+void HmlPhysics::internalRegisterHeightfield(Object& object, HeightGrid&& grid) noexcept {
+    assert(grid.countX >= 2 && grid.countZ >= 2 && grid.heights.size() == grid.countX * grid.countZ && "::> Malformed HeightGrid");
+    const size_t objectIndex = objects.size();
+    object.asHeightfield().gridIndex = static_cast<uint32_t>(heightGrids.size());
+    heightGrids.push_back(std::move(grid));
+    heightfieldObjectIndices.push_back(static_cast<uint32_t>(objectIndex));
 
-    const auto mark1 = std::chrono::high_resolution_clock::now();
-    for (auto& object : objects) {
-        if (object.isStationary()) continue;
-        // ======================== Apply adjustments ========================
-        {
-            // TODO maybe make per-object to speed up
-            for (auto it = adjustments.begin(); it != adjustments.end();) {
-                const auto& [id, _otherId, positionAdj, velocityAdj, angularMomentumAdj] = *it;
-                if (id == Object::INVALID_ID) {
-                    it = adjustments.erase(it);
-                    continue;
-                }
-                if (id == object.id) {
-                    assert(!object.isStationary() && "adjusting a stationary object");
-                    object.position                           += positionAdj;
-                    object.dynamicProperties->velocity        += velocityAdj;
-                    object.dynamicProperties->angularMomentum += angularMomentumAdj;
-                    it = adjustments.erase(it);
-                    // NOTE Don't break because there can be multiple adjustments for a single object
-                    continue;
-                }
+    // Keep the broadphases indexed by Object, but stay out of them
+    shapes.push(object);
+    allBoundingBuckets.push_back(std::make_pair(Bucket{ .x = 0, .y = 0, .z = 0 }, Bucket{ .x = -1, .y = -1, .z = -1 }));
+    switch (broadphase) {
+        case Broadphase::Grid:
+            break;
+        case Broadphase::SweepAndPrune:
+            sweepAndPrune.skip(objectIndex);
+            break;
+        case Broadphase::AabbTree:
+            treeLeafOfObject.push_back(AabbTree::NULL_NODE);
+            break;
+        default: assert(false && "Unhandled Broadphase");
+    }
 
-                ++it;
-            }
+    setObjectIndexOf(object.id, objectIndex);
+    objects.push_back(object);
+}
+
+
+void HmlPhysics::internalRemoveObject(uint32_t objectIndex) noexcept {
+    const auto& object = objects[objectIndex];
+    // Nothing keeps its sleeping neighbors up any longer. Those of a Body are
+    // in its island; what rests on a stationary Object has to be looked for.
+    if (!object.isStationary()) {
+        if (!bodies.isAwake(object.bodyIndex)) wakeIsland(sleepingIslandOfBody[object.bodyIndex]);
+        removeBody(object.bodyIndex);
+    } else if (object.isHeightfield()) {
+        const auto& grid = heightGrids[object.asHeightfield().gridIndex];
+        wakeIslandsTouching(Object::AABB{
+            .begin = glm::vec3{ grid.start.x, std::numeric_limits<float>::lowest(), grid.start.y },
+            .end   = glm::vec3{ grid.start.x + grid.cellSize.x * static_cast<float>(grid.countX - 1),
+                                std::numeric_limits<float>::max(),
+                                grid.start.y + grid.cellSize.y * static_cast<float>(grid.countZ - 1) },
+        });
+        std::erase(heightfieldObjectIndices, objectIndex);
+        removeHeightGrid(object.asHeightfield().gridIndex);
+    } else {
+        wakeIslandsTouching(shapes.aabbs[objectIndex]);
+        bucketTable.removeStatic(objectIndex);
+    }
+    switch (broadphase) {
+        case Broadphase::Grid:
+            break;
+        case Broadphase::SweepAndPrune:
+            sweepAndPrune.remove(objectIndex);
+            break;
+        case Broadphase::AabbTree: {
+            const auto leaf = treeLeafOfObject[objectIndex];
+            if (leaf != AabbTree::NULL_NODE) (object.isStationary() ? staticTree : dynamicTree).remove(leaf);
+            break;
         }
-        // ======================== Advance state ========================
-        {
-            // static constexpr glm::vec3 F {0,-9.8,0};
-            // static constexpr glm::vec3 F {0,0,0};
-            // static constexpr glm::vec3 cp{1,0,0};
-            // static constexpr glm::vec3 Ft{0,0,0};
-            const auto F = gravity;
-
-            object.position += dt * object.dynamicProperties->velocity;
-            object.dynamicProperties->velocity += dt * F; // NOTE * object.dynamicProperties->invMass;
-
-            // World-space inverse inertia tensor
-            const auto I =
-                quatToMat3(object.orientation) *
-                object.dynamicProperties->invRotationalInertiaTensor *
-                quatToMat3(glm::conjugate(object.orientation));
-            // const auto I = object.dynamicProperties->invRotationalInertiaTensor;
-            const auto angularVelocity = I * object.dynamicProperties->angularMomentum;
-            object.orientation += dt * glm::cross(glm::quat(0, angularVelocity), object.orientation);
-            // const auto torque = glm::cross(cp, Ft);
-            // object.dynamicProperties->angularMomentum += dt * torque;
-
-            // NOTE can be done not every step, but this is too trivial so we don't bother
-            object.orientation = glm::normalize(object.orientation);
-            // Invalidate modelMatrix (force further recalculation)
-            object.modelMatrixCached = std::nullopt;
-        }
-        // ======================== Reassign ========================
-        {
-            const auto boundingBucketsBefore = *boundingBoundsBeforeIt;
-            const auto boundingBucketsAfter = boundingBucketsForObject(object);
-            *boundingBoundsBeforeIt = boundingBucketsAfter; // for use during next iteration
-            ++boundingBoundsBeforeIt;
-            if (boundingBucketsBefore != boundingBucketsAfter) {
-                const auto superset = boundingBucketsSum(boundingBucketsBefore, boundingBucketsAfter);
-                for (Bucket::Coord x = superset.first.x; x <= superset.second.x; x++) {
-                    for (Bucket::Coord y = superset.first.y; y <= superset.second.y; y++) {
-                        for (Bucket::Coord z = superset.first.z; z <= superset.second.z; z++) {
-                            const Bucket b{ .x = x, .y = y, .z = z };
-                            const bool before = b.isInsideBoundingBuckets(boundingBucketsBefore);
-                            const bool after  = b.isInsideBoundingBuckets(boundingBucketsAfter);
-                            if (before && !after) { // remove from this bucket
-                                removeObjectWithIdFromBucket(object.id, b);
-                            } else if (!before && after) { // add to this bucket
-                                objectsInBuckets[b].push_back(object.id);
-                            }
-                        }
-                    }
-                }
-            }
+        default: assert(false && "Unhandled Broadphase");
+    }
+    objectIndexOfIdSlot[ObjectIds::slotOf(object.id)] = ObjectIds::NO_OBJECT_INDEX;
+    objectIds.release(object.id);
+
+    // Fill the hole with the last Object, and let everything that refers to it know
+    const auto lastIndex = static_cast<uint32_t>(objects.size() - 1);
+    if (objectIndex != lastIndex) {
+        objects[objectIndex] = objects[lastIndex];
+        const auto& moved = objects[objectIndex];
+        allBoundingBuckets[objectIndex] = allBoundingBuckets[lastIndex];
+        if (broadphase == Broadphase::AabbTree) {
+            treeLeafOfObject[objectIndex] = treeLeafOfObject[lastIndex];
+            const auto leaf = treeLeafOfObject[objectIndex];
+            if (leaf != AabbTree::NULL_NODE) (moved.isStationary() ? staticTree : dynamicTree).nodes[leaf].objectIndex = objectIndex;
+        }
+        if (!moved.isStationary()) {
+            bodies.objectIndices[moved.bodyIndex] = objectIndex;
+            bucketTable.movedBodies.push_back(moved.bodyIndex);
+        } else if (moved.isHeightfield()) {
+            std::replace(heightfieldObjectIndices.begin(), heightfieldObjectIndices.end(), lastIndex, objectIndex);
+        } else {
+            bucketTable.renameStatic(lastIndex, objectIndex);
         }
+        objectIndexOfIdSlot[ObjectIds::slotOf(moved.id)] = objectIndex;
     }
+    objects.pop_back();
+    shapes.remove(objectIndex);
+    allBoundingBuckets.pop_back();
+    if (broadphase == Broadphase::AabbTree) treeLeafOfObject.pop_back();
+}
 
-    const auto mark2 = std::chrono::high_resolution_clock::now();
-    checkForAndHandleCollisions();
-    const auto mark3 = std::chrono::high_resolution_clock::now();
 
-    static int stepTimer = 0;
-    if (false && ++stepTimer == 100) {
-        stepTimer = 0;
-        const auto step1Mks = std::chrono::duration_cast<std::chrono::microseconds>(mark2 - mark1).count();
-        const auto step2Mks = std::chrono::duration_cast<std::chrono::microseconds>(mark3 - mark2).count();
-        std::cout << "Step 1 = " << static_cast<float>(step1Mks) << " mks\n";
-        std::cout << "Step 2 = " << static_cast<float>(step2Mks) << " mks\n";
+void HmlPhysics::removeBody(Object::BodyIndex bodyIndex) noexcept {
+    // Bodies registered since the last step have no entry yet
+    sleepingIslandOfBody.resize(bodies.size(), NO_ISLAND);
+    const auto lastBody = static_cast<Object::BodyIndex>(bodies.size() - 1);
+    if (bodyIndex != lastBody) {
+        const auto sleepingIsland = sleepingIslandOfBody[lastBody];
+        if (sleepingIsland != NO_ISLAND) {
+            auto& island = sleepingIslands[sleepingIsland];
+            std::replace(island.begin(), island.end(), lastBody, bodyIndex);
+        }
+        sleepingIslandOfBody[bodyIndex] = sleepingIsland;
+        objects[bodies.objectIndices[lastBody]].bodyIndex = bodyIndex;
+        // Its entries in bucketTable are kept by Body and hold the objectIndex
+        bucketTable.movedBodies.push_back(bodyIndex);
     }
+    sleepingIslandOfBody.pop_back();
+    bodies.remove(bodyIndex);
 }
 
 
-void HmlPhysics::checkForAndHandleCollisions() noexcept {
-    assert(adjustments.empty()); // because it has been exhausted during adjustment application traversal
-
-    const auto traverseBucket = [this](
-            std::span<const Object::Id> ids,
-            Adjustments& adjustments) {
-        for (size_t i = 0; i < ids.size(); i++) {
-            const auto& obj1 = objects[objectIndexFromId[ids[i]]];
-
-            // For each object, test it against all other objects in current bucket
-            for (size_t j = i + 1; j < ids.size(); j++) {
-                const auto& obj2 = objects[objectIndexFromId[ids[j]]];
-                if (obj1.isStationary() && obj2.isStationary()) continue;
-
-                { // To prevent processing a pair if it has been processed already
-                    ObjectAdjustment fakeAdj1;
-                    fakeAdj1.id      = obj1.id;
-                    fakeAdj1.idOther = obj2.id;
-                    ObjectAdjustment fakeAdj2;
-                    fakeAdj2.id      = obj2.id;
-                    fakeAdj2.idOther = obj1.id;
-                    assert(((obj1.isStationary() || obj2.isStationary()) || // at least one static, or else
-                        (!(adjustments.contains(fakeAdj1) ^ adjustments.contains(fakeAdj2)))) && // either both present or both not present
-                        "Not mirrored adjustments for dynamic objects");
-                    if (adjustments.contains(fakeAdj1) || adjustments.contains(fakeAdj2)) continue;
-                }
-
-                const auto [adj1, adj2] = process(obj1, obj2);
-                adjustments.insert(adj1);
-                adjustments.insert(adj2);
-            }
+void HmlPhysics::removeHeightGrid(uint32_t gridIndex) noexcept {
+    const auto lastGrid = static_cast<uint32_t>(heightGrids.size() - 1);
+    if (gridIndex != lastGrid) {
+        heightGrids[gridIndex] = std::move(heightGrids[lastGrid]);
+        for (const auto objectIndex : heightfieldObjectIndices) {
+            auto& heightfield = objects[objectIndex].asHeightfield();
+            if (heightfield.gridIndex == lastGrid) heightfield.gridIndex = gridIndex;
         }
-    };
+    }
+    heightGrids.pop_back();
+}
 
-    if (hasHelperThreads()) {
-        // Get rid of empty buckets to improve traversal speed
-        for (auto it = objectsInBuckets.begin(); it != objectsInBuckets.end();) {
-            const auto& [_bucket, objects] = *it;
-            if (objects.empty()) {
-                it = objectsInBuckets.erase(it);
-                continue;
-            }
-            ++it;
-        }
-
-        // Divide the work between threads and launch them
-        const size_t poolSize = threadPool.size();
-        const auto count = objectsInBuckets.size();
-        const auto chunk = count / threadPool.size();
-        std::vector<std::future<Adjustments>> results(poolSize);
-        for (size_t threadIndex = 0; threadIndex < poolSize; threadIndex++) {
-            const bool lastThread = threadIndex + 1 == poolSize;
-            const auto startIt = std::next(objectsInBuckets.cbegin(), threadIndex * chunk);
-            const auto endIt = lastThread ? objectsInBuckets.cend() : std::next(objectsInBuckets.cbegin(), (threadIndex + 1) * chunk);
-            results[threadIndex] = threadPool.push([startIt, endIt, &traverseBucket](int){
-                Adjustments adjustments;
-                for (auto it = startIt; it != endIt; ++it) {
-                    const auto& [_bucket, ids] = *it;
-                    traverseBucket(ids, adjustments);
-                }
-                return adjustments;
-            });
-        }
 
-        // Wait on results and collect sub-adjustments
-        for (size_t threadIndex = 0; threadIndex < poolSize; threadIndex++) {
-            adjustments.merge(results[threadIndex].get());
-        }
-    } else {
-        for (auto it = objectsInBuckets.begin(); it != objectsInBuckets.end();) {
-            const auto& [_bucket, ids] = *it;
-            if (ids.empty()) {
-                it = objectsInBuckets.erase(it);
-                continue;
-            }
+void HmlPhysics::setObjectIndexOf(Object::Id id, uint32_t objectIndex) noexcept {
+    const auto slot = ObjectIds::slotOf(id);
+    if (slot >= objectIndexOfIdSlot.size()) objectIndexOfIdSlot.resize(slot + 1, ObjectIds::NO_OBJECT_INDEX);
+    objectIndexOfIdSlot[slot] = objectIndex;
+}
 
-            traverseBucket(ids, adjustments);
-            ++it;
-        }
-    }
+
+uint32_t HmlPhysics::objectIndexOf(Object::Id id) const noexcept {
+    const auto slot = ObjectIds::slotOf(id);
+    if (slot >= objectIndexOfIdSlot.size()) return ObjectIds::NO_OBJECT_INDEX;
+    const auto objectIndex = objectIndexOfIdSlot[slot];
+    // The slot may have been reused by a later Object
+    if (objectIndex == ObjectIds::NO_OBJECT_INDEX || objects[objectIndex].id != id) return ObjectIds::NO_OBJECT_INDEX;
+    return objectIndex;
 }
-// ============================================================================
-// =================== Register/remove/get ====================================
-// ============================================================================
-void HmlPhysics::internalRegisterObject(const Object& object) noexcept {
-    const auto bounds = boundingBucketsForObject(object);
-    for (Bucket::Coord x = bounds.first.x; x <= bounds.second.x; x++) {
-        for (Bucket::Coord y = bounds.first.y; y <= bounds.second.y; y++) {
-            for (Bucket::Coord z = bounds.first.z; z <= bounds.second.z; z++) {
-                const Bucket bucket{ .x = x, .y = y, .z = z };
-                objectsInBuckets[bucket].push_back(object.id);
-            }
-        }
+
+
+HmlPhysics::Object::Id HmlPhysics::ObjectIds::allocate() noexcept {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (!releasedIds.empty()) {
+        const auto id = releasedIds.back();
+        releasedIds.pop_back();
+        return id;
     }
+    assert(nextSlot <= SLOT_MASK && "::> Too many Objects");
+    // The first generation is 1, so that no Id is INVALID_ID
+    return (1u << SLOT_BITS) | nextSlot++;
+}
 
-    if (!object.isStationary()) allBoundingBucketsBefore.push_back(bounds);
-    objectIndexFromId[object.id] = objects.size();
-    objects.push_back(object);
+
+void HmlPhysics::ObjectIds::release(Object::Id id) noexcept {
+    // After the last generation comes the first one again
+    auto generation = (id >> SLOT_BITS) + 1;
+    if (generation >> (32 - SLOT_BITS)) generation = 1;
+    const std::lock_guard<std::mutex> lock(mutex);
+    releasedIds.push_back((generation << SLOT_BITS) | slotOf(id));
 }
 
 
 HmlPhysics::Object::Id HmlPhysics::registerObject(Object&& object) noexcept {
     assert(object.id == Object::INVALID_ID && "Trying to register an object with an already-set id");
+    assert(!object.isHeightfield() && "Heightfields are registered with registerHeightfield()");
 
-    // NOTE Is probably thread-safe because we only do this (interaction with IDs)
-    // from the main thread and never from the internal thread
-    const auto id = Object::generateId();
+    const auto id = objectIds.allocate();
     object.id = id;
 
     if (hasSelfThread()) {
-        // NOTE It is unlikely that internal thread will be using objectsToRegister
-        // for long, so we don't mind waiting a little (if at all) to acquire the lock.
-        const std::lock_guard<std::mutex> lock(threadedData.objectsToRegisterMutex);
-        threadedData.objectsToRegister.push_back(std::move(object));
-        threadedData.hasNewObjectsToRegister.store(true);
-        threadedData.hasNewObjectsToRegister.notify_one();
+        pushCommand(Command{ .type = Command::Type::Register, .object = std::move(object) });
+        notifyPendingCommands();
     } else {
         internalRegisterObject(std::move(object));
     }
@@ -684,23 +3429,40 @@ HmlPhysics::Object::Id HmlPhysics::registerObject(Object&& object) noexcept {
 }
 
 
-void HmlPhysics::removeObjectWithIdFromBucket(Object::Id id, const Bucket& bucket) noexcept {
-    auto& idsInBucket = objectsInBuckets[bucket];
-    const auto size = idsInBucket.size();
-    for (size_t i = 0; i < size; i++) {
-        if (idsInBucket[i] == id) {
-            // NOTE we don't check if this is the same object to remove the unnesessary if
-            // NOTE swap, but with fewer steps because we'll remove the current object anyway
-            idsInBucket[i] = idsInBucket[size - 1];
-            idsInBucket.pop_back();
-            return;
-        }
+HmlPhysics::Object::Id HmlPhysics::registerHeightfield(HeightGrid&& grid) noexcept {
+    Object object{Object::Type::Heightfield};
+    object.position = glm::vec3{ grid.start.x, 0.0f, grid.start.y };
+    object.dimensions = { 0.0f, 0.0f, 0.0f };
+    const auto id = objectIds.allocate();
+    object.id = id;
+
+    if (hasSelfThread()) {
+        pushCommand(Command{ .type = Command::Type::Register, .object = std::move(object),
+            .heightGrid = std::make_unique<HeightGrid>(std::move(grid)) });
+        notifyPendingCommands();
+    } else {
+        internalRegisterHeightfield(object, std::move(grid));
+    }
+
+    return id;
+}
+
+
+std::vector<HmlPhysics::Object::Id> HmlPhysics::registerObjects(std::span<Object> objectsToRegister) noexcept {
+    std::vector<Object::Id> ids;
+    ids.reserve(objectsToRegister.size());
+    for (auto& object : objectsToRegister) {
+        assert(object.id == Object::INVALID_ID && "Trying to register an object with an already-set id");
+        const auto id = objectIds.allocate();
+        object.id = id;
+        ids.push_back(id);
+
+        if (hasSelfThread()) pushCommand(Command{ .type = Command::Type::Register, .object = std::move(object) });
+        else internalRegisterObject(std::move(object));
     }
-    std::cout << size << '\n';
-    std::cout << bucket.x << " " << bucket.y << " " << bucket.z << std::endl;
-    const auto& object = objects[objectIndexFromId[id]];
-    std::cout << object.position << std::endl;
-    assert(false && "::> There was no such Object in the Bucket");
+    if (hasSelfThread()) notifyPendingCommands();
+
+    return ids;
 }
 
 
@@ -717,56 +3479,324 @@ void HmlPhysics::removeObjectWithIdFromBucket(Object::Id id, const Bucket& bucke
 // }
 
 
-std::vector<std::pair<HmlPhysics::Object::Id, glm::mat4>> HmlPhysics::getModelMatrices() noexcept {
-    if (hasSelfThread()) {
-        const std::lock_guard<std::mutex> lock(threadedData.modelMatricesMutex);
-        const std::vector<std::pair<Object::Id, glm::mat4>> copy = threadedData.modelMatrices;
-        return copy;
-    } else {
-        std::vector<std::pair<Object::Id, glm::mat4>> modelMatrices;
-        modelMatrices.reserve(objects.size());
-        for (const auto& object : objects) modelMatrices.push_back(std::make_pair(object.id, object.modelMatrix()));
-        return modelMatrices;
+std::span<const std::pair<HmlPhysics::Object::Id, glm::mat4>> HmlPhysics::getModelMatrices() noexcept {
+    if (!hasSelfThread()) publishModelMatrices();
+    return modelMatrices.latest();
+}
+
+
+void HmlPhysics::publishModelMatrices() noexcept {
+    auto& slot = modelMatrices.back();
+    slot.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        // NOTE Not from shapes, which the solver has left a step behind
+        slot[i] = std::make_pair(objects[i].id, objects[i].modelMatrix());
+    }
+    modelMatrices.publish();
+}
+
+
+void HmlPhysics::ModelMatricesTripleBuffer::publish() noexcept {
+    // Release our writes to the reader and acquire the slot it has abandoned
+    backIndex = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+
+const HmlPhysics::ModelMatricesTripleBuffer::Slot& HmlPhysics::ModelMatricesTripleBuffer::latest() noexcept {
+    if (middle.load(std::memory_order_relaxed) & FRESH_BIT) {
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
     }
+    return slots[frontIndex];
+}
+
+
+void HmlPhysics::StepStatsSeqlock::publish(const StepStats& stats) noexcept {
+    static_assert(std::is_trivially_copyable_v<StepStats>, "::> StepStats are copied word by word");
+    std::array<uint64_t, WORD_COUNT> copy{};
+    std::memcpy(copy.data(), &stats, sizeof(StepStats));
+    const auto begin = sequence.load(std::memory_order_relaxed);
+    sequence.store(begin + 1, std::memory_order_relaxed);
+    // The readers that see any of the new words also see the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORD_COUNT; i++) words[i].store(copy[i], std::memory_order_relaxed);
+    sequence.store(begin + 2, std::memory_order_release);
+}
+
 
+HmlPhysics::StepStats HmlPhysics::StepStatsSeqlock::latest() const noexcept {
+    std::array<uint64_t, WORD_COUNT> copy;
+    uint32_t begin, end;
+    do {
+        begin = sequence.load(std::memory_order_acquire);
+        for (size_t i = 0; i < WORD_COUNT; i++) copy[i] = words[i].load(std::memory_order_relaxed);
+        // Keeps the loads of the words above the second load of the sequence
+        std::atomic_thread_fence(std::memory_order_acquire);
+        end = sequence.load(std::memory_order_relaxed);
+    } while (begin != end || (begin & 1));
+    StepStats stats;
+    std::memcpy(static_cast<void*>(&stats), copy.data(), sizeof(StepStats));
+    return stats;
 }
 
 
 void HmlPhysics::setGravity(const glm::vec3& newGravity) noexcept {
     gravity = newGravity;
 }
+
+
+void HmlPhysics::setSolverIterations(int velocityIterations, int positionIterations) noexcept {
+    Command command{ .type = Command::Type::SetSolverIterations, .solverSettings = SolverSettings{
+        .velocityIterations = velocityIterations,
+        .positionIterations = positionIterations,
+    }};
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
+
+
+void HmlPhysics::setGridLevels(float finestCellSize, size_t levelCount) noexcept {
+    assert(finestCellSize > 0.0f && "::> The cells must have a size");
+    assert(1 <= levelCount && levelCount <= GridLevels::MAX_COUNT && "::> Unsupported number of grid levels");
+    Command command{ .type = Command::Type::SetGridLevels, .gridLevels = GridLevels{
+        .finestCellSize = finestCellSize,
+        .count = static_cast<Bucket::Level>(levelCount),
+    }};
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
+
+
+void HmlPhysics::removeObject(Object::Id id) noexcept {
+    Command command{ .type = Command::Type::Remove, .id = id };
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
+
+
+void HmlPhysics::applyImpulse(Object::Id id, const glm::vec3& impulse) noexcept {
+    Command command{ .type = Command::Type::ApplyImpulse, .id = id, .vector = impulse };
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
+
+
+void HmlPhysics::setVelocity(Object::Id id, const glm::vec3& velocity) noexcept {
+    Command command{ .type = Command::Type::SetVelocity, .id = id, .vector = velocity };
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
+
+
+void HmlPhysics::setTransform(Object::Id id, const glm::vec3& position, const glm::quat& orientation) noexcept {
+    Command command{ .type = Command::Type::SetTransform, .id = id, .vector = position, .orientation = orientation };
+    if (hasSelfThread()) {
+        pushCommand(std::move(command));
+        notifyPendingCommands();
+    } else {
+        executeCommand(command);
+    }
+}
 // ============================================================================
-// =================== BoundingBuckets ========================================
+// =================== Commands ===============================================
 // ============================================================================
-inline HmlPhysics::Bucket::Bounding HmlPhysics::boundingBucketsSum(const Bucket::Bounding& bb1, const Bucket::Bounding& bb2) noexcept {
-    return std::make_pair(
-        Bucket{
-            .x = std::min(bb1.first.x, bb2.first.x),
-            .y = std::min(bb1.first.y, bb2.first.y),
-            .z = std::min(bb1.first.z, bb2.first.z),
-        },
-        Bucket{
-            .x = std::max(bb1.second.x, bb2.second.x),
-            .y = std::max(bb1.second.y, bb2.second.y),
-            .z = std::max(bb1.second.z, bb2.second.z),
+HmlPhysics::CommandRing::CommandRing() noexcept : cells(std::make_unique<Cell[]>(CAPACITY)) {
+    for (size_t i = 0; i < CAPACITY; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+
+bool HmlPhysics::CommandRing::tryPush(Command& command) noexcept {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        auto& cell = cells[position & MASK];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if (diff == 0) {
+            // The cell is free for this position, try to claim it
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.command = std::move(command);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // the consumer has not freed the cell yet
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed); // another producer got ahead
+        }
+    }
+}
+
+
+bool HmlPhysics::CommandRing::tryPop(Command& command) noexcept {
+    auto& cell = cells[dequeuePosition & MASK];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) return false; // not written yet
+    command = std::move(cell.command);
+    cell.command.object.reset();
+    cell.command.heightGrid.reset();
+    cell.command.gridLevels.reset();
+    cell.sequence.store(dequeuePosition + CAPACITY, std::memory_order_release);
+    dequeuePosition++;
+    return true;
+}
+
+
+void HmlPhysics::pushCommand(Command&& command) noexcept {
+    if (!threadedData.overflowing.load() && threadedData.commands.tryPush(command)) return;
+
+    // Slow path: a burst larger than the ring, or still catching up with one
+    const std::lock_guard<std::mutex> lock(threadedData.overflowCommandsMutex);
+    if (!threadedData.overflowing.load() && threadedData.commands.tryPush(command)) return;
+    threadedData.overflowing.store(true);
+    threadedData.overflowCommands.push_back(std::move(command));
+}
+
+
+void HmlPhysics::notifyPendingCommands() noexcept {
+    // Only the first producer since the last drain needs to wake the thread up
+    if (threadedData.hasPendingCommands.exchange(true)) return;
+    threadedData.hasPendingCommands.notify_one();
+}
+
+
+void HmlPhysics::drainCommands() noexcept {
+    if (!threadedData.hasPendingCommands.exchange(false)) return;
+
+    Command command{ .type = Command::Type::Register };
+    while (threadedData.commands.tryPop(command)) executeCommand(command);
+
+    // Everything that has overflowed is newer than what was in the ring
+    if (threadedData.overflowing.load()) {
+        {
+            const std::lock_guard<std::mutex> lock(threadedData.overflowCommandsMutex);
+            std::swap(threadedData.overflowCommands, threadedData.drainedOverflowCommands);
+            threadedData.overflowing.store(false);
         }
-    );
+        for (auto& overflowCommand : threadedData.drainedOverflowCommands) executeCommand(overflowCommand);
+        threadedData.drainedOverflowCommands.clear();
+    }
+}
+
+
+void HmlPhysics::executeCommand(Command& command) noexcept {
+    if (command.type == Command::Type::Register) {
+        assert(command.object && "::> A Register Command without an Object");
+        if (command.heightGrid) internalRegisterHeightfield(*command.object, std::move(*command.heightGrid));
+        else internalRegisterObject(*command.object);
+        return;
+    }
+    if (command.type == Command::Type::SetGridLevels) {
+        assert(command.gridLevels && "::> A SetGridLevels Command without GridLevels");
+        internalSetGridLevels(*command.gridLevels);
+        return;
+    }
+    if (command.type == Command::Type::SetSolverIterations) {
+        assert(command.solverSettings && "::> A SetSolverIterations Command without SolverSettings");
+        solverSettings = *command.solverSettings;
+        return;
+    }
+
+    const auto objectIndex = objectIndexOf(command.id);
+    if (objectIndex == ObjectIds::NO_OBJECT_INDEX) return; // removed in the meantime
+    if (command.type == Command::Type::Remove) {
+        internalRemoveObject(objectIndex);
+        return;
+    }
+    auto& object = objects[objectIndex];
+    assert(!object.isStationary() && "::> Stationary Objects cannot be changed");
+    const auto bodyIndex = object.bodyIndex;
+    switch (command.type) {
+        case Command::Type::ApplyImpulse:
+            bodies.addVelocity(bodyIndex, command.vector * object.dynamicProperties->invMass);
+            break;
+        case Command::Type::SetVelocity:
+            bodies.setVelocity(bodyIndex, command.vector);
+            break;
+        case Command::Type::SetTransform:
+            bodies.setPosition(bodyIndex, command.vector);
+            bodies.setOrientation(bodyIndex, command.orientation);
+            object.position = command.vector;
+            object.orientation = command.orientation;
+            break;
+        default: assert(false && "Unhandled Command::Type");
+    }
+    if (!bodies.isAwake(bodyIndex)) wakeIsland(sleepingIslandOfBody[bodyIndex]);
+}
+// ============================================================================
+// =================== BoundingBuckets ========================================
+// ============================================================================
+inline HmlPhysics::Bucket::Bounding HmlPhysics::boundingBucketsForAabb(const Object::AABB& aabb) const noexcept {
+    const auto level = gridLevels.levelFor(aabb);
+    return std::make_pair(gridLevels.bucketAt(aabb.begin, level), gridLevels.bucketAt(aabb.end, level));
+}
+
+
+HmlPhysics::Bucket::Level HmlPhysics::GridLevels::levelFor(const Object::AABB& aabb) const noexcept {
+    const auto size = aabb.end - aabb.begin;
+    const float extent = std::max(size.x, std::max(size.y, size.z));
+    Bucket::Level level = 0;
+    while (level + 1 < count && cellSize(level) < extent) level++;
+    return level;
 }
 
 
-inline HmlPhysics::Bucket::Bounding HmlPhysics::boundingBucketsForObject(const Object& object) noexcept {
-    const auto aabb = object.aabb();
-    const auto begin = Bucket::fromPos(aabb.begin);
-    const auto end = Bucket::fromPos(aabb.end);
-    return std::make_pair(begin, end);
+void HmlPhysics::internalSetGridLevels(const GridLevels& levels) noexcept {
+    gridLevels = levels;
+    for (size_t objectIndex = 0; objectIndex < objects.size(); objectIndex++) {
+        if (objects[objectIndex].isHeightfield()) continue; // in no Bucket
+        allBoundingBuckets[objectIndex] = boundingBucketsForAabb(shapes.aabbs[objectIndex]);
+    }
+    bucketTable.needsFullRebuild = true;
 }
 
 
 void HmlPhysics::printStats() const noexcept {
+    std::cout << "Broadphase: ";
+    switch (broadphase) {
+        case Broadphase::Grid:          std::cout << "Grid"; break;
+        case Broadphase::SweepAndPrune: std::cout << "SweepAndPrune (axis=" << sweepAndPrune.axis << ")"; break;
+        case Broadphase::AabbTree:
+            std::cout << "AabbTree (static: " << staticTree.leafCount << " leaves, height " << staticTree.height()
+                << "; dynamic: " << dynamicTree.leafCount << " leaves, height " << dynamicTree.height() << ")";
+            break;
+    }
+    std::cout << "; Objects=" << objects.size() << "; Bodies=" << bodies.size() << " (awake " << stepStats.awakeBodies << ")"
+        << "; Candidate pairs=" << stepStats.candidatePairs << "\n";
+    std::cout << "Integration=" << stepStats.integrationMicros
+        << "mks; Broadphase=" << stepStats.broadphaseMicros
+        << "mks; Narrowphase=" << stepStats.narrowphaseMicros << "mks\n";
+    std::cout << "Grid levels (cell size: entries):";
+    for (Bucket::Level level = 0; level < gridLevels.count; level++) {
+        std::cout << " " << gridLevels.cellSize(level) << ": " << bucketTable.entryCountOfLevel[level];
+    }
+    std::cout << "\n";
+    if (broadphase != Broadphase::Grid) return;
+
     std::map<uint32_t, uint32_t> countOfBucketsWithSize;
-    for (const auto& [bucket, ids] : objectsInBuckets) {
-        const auto size = ids.size();
+    size_t nonEmptyBucketCount = 0;
+    for (const auto slot : bucketTable.usedSlots) {
+        const auto size = bucketTable.slots[slot].count;
+        if (size == 0) continue; // the key is kept from a previous step
         countOfBucketsWithSize[size]++;
+        nonEmptyBucketCount++;
     }
 
     uint32_t min = std::numeric_limits<uint32_t>::max();
@@ -779,7 +3809,7 @@ void HmlPhysics::printStats() const noexcept {
         avg += size * count;
     }
 
-    std::cout << "Min size=" << min << "; Max size=" << max << "; Avg in bucket=" << (avg / objectsInBuckets.size()) << "\n";
+    std::cout << "Min size=" << min << "; Max size=" << max << "; Avg in bucket=" << (avg / nonEmptyBucketCount) << "\n";
 }
 
 
@@ -890,6 +3920,65 @@ glm::vec3 HmlPhysics::calcSupport(const glm::vec3& dir, std::span<const glm::vec
 }
 
 
+glm::vec3 HmlPhysics::calcSupport(const glm::vec3& dir, const ConvexVertices& vs1, const ConvexVertices& vs2) noexcept {
+    return vs1.furthestPointInDir(dir) - vs2.furthestPointInDir(-dir);
+}
+
+
+HmlPhysics::ConvexVertices::ConvexVertices(std::span<const glm::vec3> ps) noexcept
+        : chunks((ps.size() + 7) / 8) {
+    assert(!ps.empty() && chunks <= MAX_CHUNKS && "Unsupported vertex count for ConvexVertices");
+    for (size_t i = 0; i < chunks * 8; i++) {
+        // A copy of an existing vertex never changes the support point
+        const auto& p = (i < ps.size()) ? ps[i] : ps[0];
+        xs[i] = p.x;
+        ys[i] = p.y;
+        zs[i] = p.z;
+    }
+}
+
+
+HmlPhysics::ConvexVertices HmlPhysics::ConvexVertices::ofBox(const Object::Box& box) noexcept {
+    const auto ps = box.toPoints();
+    return ConvexVertices{ ps };
+}
+
+
+glm::vec3 HmlPhysics::ConvexVertices::furthestPointInDir(const glm::vec3& dir) const noexcept {
+    const __m256 dirX = _mm256_set1_ps(dir.x);
+    const __m256 dirY = _mm256_set1_ps(dir.y);
+    const __m256 dirZ = _mm256_set1_ps(dir.z);
+    // Keep the best vertex per lane across the chunks...
+    __m256 bestProj = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    __m256 bestX = _mm256_setzero_ps();
+    __m256 bestY = _mm256_setzero_ps();
+    __m256 bestZ = _mm256_setzero_ps();
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        const __m256 x = _mm256_load_ps(&xs[8 * chunk]);
+        const __m256 y = _mm256_load_ps(&ys[8 * chunk]);
+        const __m256 z = _mm256_load_ps(&zs[8 * chunk]);
+        const __m256 proj = _mm256_add_ps(_mm256_mul_ps(x, dirX), _mm256_add_ps(_mm256_mul_ps(y, dirY), _mm256_mul_ps(z, dirZ)));
+        const __m256 better = _mm256_cmp_ps(proj, bestProj, _CMP_GT_OQ);
+        bestProj = _mm256_blendv_ps(bestProj, proj, better);
+        bestX = _mm256_blendv_ps(bestX, x, better);
+        bestY = _mm256_blendv_ps(bestY, y, better);
+        bestZ = _mm256_blendv_ps(bestZ, z, better);
+    }
+    // ...then the best lane: broadcast the horizontal max and find where it came from
+    __m256 max = _mm256_max_ps(bestProj, _mm256_permute2f128_ps(bestProj, bestProj, 0x01));
+    max = _mm256_max_ps(max, _mm256_permute_ps(max, 0b01001110));
+    max = _mm256_max_ps(max, _mm256_permute_ps(max, 0b10110001));
+    const int isMax = _mm256_movemask_ps(_mm256_cmp_ps(bestProj, max, _CMP_EQ_OQ));
+    const int lane = isMax ? std::countr_zero(static_cast<unsigned int>(isMax)) : 0; // 0 only for NaN dir
+
+    alignas(32) float lanes[3][8];
+    _mm256_store_ps(lanes[0], bestX);
+    _mm256_store_ps(lanes[1], bestY);
+    _mm256_store_ps(lanes[2], bestZ);
+    return glm::vec3{ lanes[0][lane], lanes[1][lane], lanes[2][lane] };
+}
+
+
 std::optional<HmlPhysics::Detection> HmlPhysics::gjk(const Object::Box& b1, const Object::Box& b2) noexcept {
     static const auto sameDir = [](const glm::vec3& a, const glm::vec3& b){
         return glm::dot(a, b) >= 0.0f;
@@ -975,136 +4064,149 @@ std::optional<HmlPhysics::Detection> HmlPhysics::gjk(const Object::Box& b1, cons
     };
 
     const glm::vec3 initialDir{1, 0, 0};
-    const auto ps1 = b1.toPoints();
-    const auto ps2 = b2.toPoints();
+    const auto ps1 = ConvexVertices::ofBox(b1);
+    const auto ps2 = ConvexVertices::ofBox(b2);
     auto support = calcSupport(initialDir, ps1, ps2);
 
     Simplex simplex;
     simplex.push_front(support);
 
     glm::vec3 dir = -support;
-    while (true) {
+    for (size_t iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++) {
         support = calcSupport(dir, ps1, ps2);
         if (glm::dot(support, dir) <= 0.0f) return std::nullopt; // no collision
         simplex.push_front(support);
         if (nextSimplex(simplex, dir)) {
+            // NOTE EPA can still fail if the origin is right on the surface of the Minkowski difference
             auto detOpt = epa(simplex, ps1, ps2);
-            assert(detOpt && "EPA result differs from GJK");
             // detOpt->contactPoints = { avg(std::span(simplex.begin(), simplex.end())) };
             return detOpt;
         }
     }
 
-    return std::nullopt;
+    return std::nullopt; // ran out of iterations, must be touching at most
+}
+
+
+std::optional<std::pair<glm::vec3, float>> HmlPhysics::penetrationGjk(const Object& box1, const Object& box2) noexcept {
+    assert(box1.isBox() && box2.isBox() && "penetrationGjk() is only for Boxes");
+    const auto detectionOpt = gjk(box1.asBox(), box2.asBox());
+    if (!detectionOpt) return std::nullopt;
+    return std::make_pair(detectionOpt->dir, detectionOpt->extent);
 }
 // ============================================================================
 // ===================== EPA ==================================================
 // ============================================================================
-std::optional<HmlPhysics::Detection> HmlPhysics::epa(const Simplex& simplex, const auto& ps1, const auto& ps2) noexcept {
-    static const auto getFaceNormals = [](
-            const std::vector<glm::vec3>& polytope,
-            const std::vector<size_t>& faces){
-        std::vector<glm::vec4> normals;
-        size_t minTriangle = 0;
-        float minDst = std::numeric_limits<float>::max();
-
-        for (size_t i = 0; i < faces.size(); i += 3) {
-            const auto& a = polytope[faces[i + 0]];
-            const auto& b = polytope[faces[i + 1]];
-            const auto& c = polytope[faces[i + 2]];
-
-            auto normal = glm::normalize(glm::cross(b - a, c - a));
-            float dst = glm::dot(normal, a);
-            if (dst < 0) {
-                normal *= -1.0f;
-                dst    *= -1.0f;
-            }
-
-            normals.emplace_back(normal.x, normal.y, normal.z, dst);
-            if (dst < minDst) {
-                minTriangle = i / 3;
-                minDst = dst;
-            }
-        }
-
-        return std::make_pair<std::vector<glm::vec4>, size_t>(std::move(normals), std::move(minTriangle));
-    };
-    static const auto addIfUniqueEdge = [](std::vector<std::pair<size_t, size_t>>& edges, const std::vector<size_t>& faces, size_t a, size_t b){
-        //    0--<--3
-        //   / \ B /  A: 2-0
-        //  / A \ /   B: 0-2
-        // 1-->--2
-        const auto reverse = std::find(edges.begin(), edges.end(), std::make_pair(faces[b], faces[a]));
-        if (reverse != edges.end()) edges.erase(reverse);
-        else edges.emplace_back(faces[a], faces[b]);
-    };
-
-    std::vector<glm::vec3> polytope(simplex.begin(), simplex.end());
-    std::vector<size_t> faces = {
-        0, 1, 2,
-        0, 3, 1,
-        0, 2, 3,
-        1, 3, 2
-    };
-
-    auto [normals, minFace] = getFaceNormals(polytope, faces);
-
-    float minDst = std::numeric_limits<float>::max();
-    glm::vec3 minNormal;
-    while (minDst == std::numeric_limits<float>::max()) {
-        minNormal = glm::vec3(normals[minFace]);
-        minDst = normals[minFace].w;
-
-        const auto support = calcSupport(minNormal, ps1, ps2);
-        const float supportDst = glm::dot(minNormal, support);
-        if (std::abs(supportDst - minDst) > 0.001f) {
-            minDst = std::numeric_limits<float>::max();
-
-            std::vector<std::pair<size_t, size_t>> uniqueEdges;
-            for (size_t i = 0; i < normals.size(); i++) {
-                if (glm::dot(glm::vec3(normals[i]), support) < 0.0f) continue;
+void HmlPhysics::Polytope::addFace(uint8_t a, uint8_t b, uint8_t c) noexcept {
+    assert(faceCount < MAX_FACES && "Polytope is out of faces");
+    const auto& pa = points[a];
+    const auto cross = glm::cross(points[b] - pa, points[c] - pa);
+    const float length = glm::length(cross);
+    // A degenerate face is kept to keep the polytope closed, but is never the closest one
+    if (length < 1e-12f) {
+        faces[faceCount] = { a, b, c };
+        normals[faceCount] = glm::vec4{ 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max() };
+        faceCount++;
+        return;
+    }
+    auto normal = cross / length;
+    float dst = glm::dot(normal, pa);
+    if (dst < 0.0f) {
+        normal *= -1.0f;
+        dst    *= -1.0f;
+        std::swap(b, c);
+    }
+    faces[faceCount] = { a, b, c };
+    normals[faceCount] = glm::vec4{ normal.x, normal.y, normal.z, dst };
+    faceCount++;
+}
 
-                size_t f = i * 3;
-                addIfUniqueEdge(uniqueEdges, faces, f + 0, f + 1);
-                addIfUniqueEdge(uniqueEdges, faces, f + 1, f + 2);
-                addIfUniqueEdge(uniqueEdges, faces, f + 2, f + 0);
 
-                faces[f + 2] = faces.back(); faces.pop_back();
-                faces[f + 1] = faces.back(); faces.pop_back();
-                faces[f + 0] = faces.back(); faces.pop_back();
-                normals[i] = normals.back(); normals.pop_back();
+void HmlPhysics::Polytope::removeFace(size_t f) noexcept {
+    faceCount--;
+    faces[f] = faces[faceCount];
+    normals[f] = normals[faceCount];
+}
 
-                i--;
-            }
 
-            std::vector<size_t> newFaces;
-            for (const auto& [edgeIndex1, edgeIndex2] : uniqueEdges) {
-                newFaces.push_back(edgeIndex1);
-                newFaces.push_back(edgeIndex2);
-                newFaces.push_back(polytope.size());
-            }
+bool HmlPhysics::Polytope::addUniqueEdge(uint8_t a, uint8_t b) noexcept {
+    //    0--<--3
+    //   / \ B /  A: 2-0
+    //  / A \ /   B: 0-2
+    // 1-->--2
+    for (size_t e = 0; e < edgeCount; e++) {
+        if (edges[e] == Edge{ b, a }) {
+            edges[e] = edges[--edgeCount];
+            return true;
+        }
+    }
+    if (edgeCount == MAX_EDGES) return false;
+    edges[edgeCount++] = { a, b };
+    return true;
+}
 
-            polytope.push_back(support);
 
-            const auto& [newNormals, newMinFace] = getFaceNormals(polytope, newFaces);
+size_t HmlPhysics::Polytope::closestFace() const noexcept {
+    size_t minFace = 0;
+    for (size_t f = 1; f < faceCount; f++) {
+        if (normals[f].w < normals[minFace].w) minFace = f;
+    }
+    return minFace;
+}
 
-            float oldMinDst = std::numeric_limits<float>::max();
-            for (size_t i = 0; i < normals.size(); i++) {
-                if (normals[i].w < oldMinDst) {
-                    oldMinDst = normals[i].w;
-                    minFace = i;
-                }
-            }
 
-            if (newNormals[newMinFace].w < oldMinDst) {
-                minFace = newMinFace + normals.size();
-            }
+std::optional<HmlPhysics::Detection> HmlPhysics::epa(const Simplex& simplex, const auto& ps1, const auto& ps2) noexcept {
+    Polytope polytope;
+    for (const auto& p : simplex) polytope.points[polytope.pointCount++] = p;
+    polytope.addFace(0, 1, 2);
+    polytope.addFace(0, 3, 1);
+    polytope.addFace(0, 2, 3);
+    polytope.addFace(1, 3, 2);
+
+    // Stops at the closest face found so far if the iterations or the storage run out
+    size_t minFace = polytope.closestFace();
+    for (size_t iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+        const glm::vec3 minNormal{ polytope.normals[minFace] };
+        const float minDst = polytope.normals[minFace].w;
+        const auto support = calcSupport(minNormal, ps1, ps2);
+        if (std::abs(glm::dot(minNormal, support) - minDst) <= 0.001f) break;
+        if (polytope.pointCount == Polytope::MAX_POINTS) break;
+
+        // Remove the faces that can see the support point, remembering their outline
+        polytope.edgeCount = 0;
+        bool edgesFit = true;
+        for (size_t f = 0; f < polytope.faceCount; f++) {
+            const auto& [a, b, c] = polytope.faces[f];
+            if (glm::dot(glm::vec3(polytope.normals[f]), support - polytope.points[a]) <= 0.0f) continue;
+            edgesFit &= polytope.addUniqueEdge(a, b);
+            edgesFit &= polytope.addUniqueEdge(b, c);
+            edgesFit &= polytope.addUniqueEdge(c, a);
+            polytope.removeFace(f);
+            f--;
+        }
+        if (!edgesFit || polytope.faceCount + polytope.edgeCount > Polytope::MAX_FACES) {
+            // Can't close the polytope anymore, so the last closest face is the answer
+            return Detection{
+                .dir = minNormal,
+                .extent = minDst + 0.001f,
+                .contactPoints = {},
+            };
+        }
 
-            faces  .insert(faces  .end(), newFaces  .begin(), newFaces  .end());
-            normals.insert(normals.end(), newNormals.begin(), newNormals.end());
+        // Fill the hole with the faces from the outline to the new point
+        const auto newPoint = static_cast<uint8_t>(polytope.pointCount);
+        polytope.points[polytope.pointCount++] = support;
+        for (size_t e = 0; e < polytope.edgeCount; e++) {
+            const auto& [a, b] = polytope.edges[e];
+            polytope.addFace(a, b, newPoint);
         }
+        if (polytope.faceCount == 0) return std::nullopt;
+        minFace = polytope.closestFace();
     }
 
+    const glm::vec3 minNormal{ polytope.normals[minFace] };
+    const float minDst = polytope.normals[minFace].w;
+    if (minDst == std::numeric_limits<float>::max()) return std::nullopt; // the simplex was flat
     return Detection{
         .dir = minNormal,
         .extent = minDst + 0.001f,
@@ -1228,12 +4330,7 @@ glm::mat3 quatToMat3(const glm::quat& q) noexcept {
 // ============================================================================
 // ======================== Object ============================================
 // ============================================================================
-const glm::mat4& HmlPhysics::Object::modelMatrix() const noexcept {
-    if (!modelMatrixCached) modelMatrixCached = generateModelMatrix();
-    return *modelMatrixCached;
-}
-
-glm::mat4 HmlPhysics::Object::generateModelMatrix() const noexcept {
+glm::mat4 HmlPhysics::Object::modelMatrix() const noexcept {
     auto modelMatrix = glm::mat4(1.0f);
     switch (type) {
         case Type::Box: {
@@ -1252,6 +4349,10 @@ glm::mat4 HmlPhysics::Object::generateModelMatrix() const noexcept {
             // modelMatrix = glm::rotate(modelMatrix, glm::radians(90.0f), glm::vec3(1, 0, 0));
             break;
         }
+        case Type::Heightfield: {
+            modelMatrix = glm::translate(modelMatrix, asHeightfield().start);
+            break;
+        }
         default: assert(false && "::> Unimplemented object type.");
     }
     return modelMatrix;
@@ -1269,6 +4370,7 @@ bool HmlPhysics::Object::AABB::intersects(const AABB& other) const noexcept {
 
 bool HmlPhysics::Object::isSphere() const noexcept { return type == Type::Sphere; }
 bool HmlPhysics::Object::isBox()    const noexcept { return type == Type::Box; }
+bool HmlPhysics::Object::isHeightfield() const noexcept { return type == Type::Heightfield; }
 
 HmlPhysics::Object::Sphere& HmlPhysics::Object::asSphere() noexcept {
     assert(isSphere() && "::> Trying to convert Object to Sphere but it is not one!");
@@ -1286,6 +4388,14 @@ const HmlPhysics::Object::Box& HmlPhysics::Object::asBox() const noexcept {
     assert(isBox() && "::> Trying to convert Object to Box but it is not one!");
     return *reinterpret_cast<const Box*>(this);
 }
+HmlPhysics::Object::Heightfield& HmlPhysics::Object::asHeightfield() noexcept {
+    assert(isHeightfield() && "::> Trying to convert Object to Heightfield but it is not one!");
+    return *reinterpret_cast<Heightfield*>(this);
+}
+const HmlPhysics::Object::Heightfield& HmlPhysics::Object::asHeightfield() const noexcept {
+    assert(isHeightfield() && "::> Trying to convert Object to Heightfield but it is not one!");
+    return *reinterpret_cast<const Heightfield*>(this);
+}
 
 HmlPhysics::Object HmlPhysics::Object::createSphere(const glm::vec3& center, float radius) noexcept {
     Object object{Type::Sphere};
@@ -1339,20 +4449,21 @@ glm::mat3 HmlPhysics::Object::Sphere::rotationalInertiaTensor(float mass) const
 // ======================== Box ===============================================
 // ============================================================================
 HmlPhysics::Object::Box::OrientationData HmlPhysics::Object::Box::orientationDataNormalized() const noexcept {
-    const auto& mm = asObject().modelMatrix();
+    // The columns of the rotation matrix
+    const auto rotation = glm::mat3_cast(glm::normalize(asObject().orientation));
     return OrientationData{
-        .i = glm::normalize(glm::vec3{ mm[0][0], mm[0][1], mm[0][2] }),
-        .j = glm::normalize(glm::vec3{ mm[1][0], mm[1][1], mm[1][2] }),
-        .k = glm::normalize(glm::vec3{ mm[2][0], mm[2][1], mm[2][2] })
+        .i = rotation[0],
+        .j = rotation[1],
+        .k = rotation[2]
     };
 }
 
 HmlPhysics::Object::Box::OrientationData HmlPhysics::Object::Box::orientationDataUnnormalized() const noexcept {
-    const auto& mm = asObject().modelMatrix();
+    const auto& [i, j, k] = orientationDataNormalized();
     return OrientationData{
-        .i = glm::vec3{ mm[0][0], mm[0][1], mm[0][2] },
-        .j = glm::vec3{ mm[1][0], mm[1][1], mm[1][2] },
-        .k = glm::vec3{ mm[2][0], mm[2][1], mm[2][2] }
+        .i = i * halfDimensions.x,
+        .j = j * halfDimensions.y,
+        .k = k * halfDimensions.z
     };
 }
 
@@ -1427,7 +4538,7 @@ void HmlPhysics::findContactPointsBoxes(
         std::span<const glm::vec3> psFrom,
         std::span<const glm::vec3> psOnto,
         const Object::Box::OrientationData& orientationDataOnto,
-        std::vector<glm::vec3>& contactPoints) noexcept {
+        ContactManifold& contactPoints) noexcept {
     static const std::array<std::pair<size_t, size_t>, 12> edges{
         std::make_pair(0, 1), std::make_pair(2, 3), std::make_pair(0, 2), std::make_pair(1, 3),
         std::make_pair(4, 5), std::make_pair(6, 7), std::make_pair(4, 6), std::make_pair(5, 7),
@@ -1456,7 +4567,7 @@ void HmlPhysics::findContactPointsBoxes(
             const auto intOpt = edgePlaneIntersection(linePoint1, linePoint2, planePoint, planeDir);
             if (!intOpt) continue;
             if (pointInsideRect(*intOpt, psOnto[face[0]], psOnto[face[1]], psOnto[face[2]])) {
-                contactPoints.push_back(*intOpt);
+                contactPoints.add(*intOpt);
             }
         }
     }
@@ -1467,7 +4578,7 @@ void HmlPhysics::findContactPointsBoxesAvxCompact(
         std::span<const glm::vec3> psFrom,
         std::span<const glm::vec3> psOnto,
         const Object::Box::OrientationData& orientationDataOnto,
-        std::vector<glm::vec3>& contactPoints) noexcept {
+        ContactManifold& contactPoints) noexcept {
     const int c = 3;
     const int DC = c*0; // don't care
     // Input
@@ -1512,11 +4623,11 @@ void HmlPhysics::findContactPointsBoxesAvxCompact(
         // Process result
         for (size_t e = 2; e < 8; e++) {
             const glm::vec3 p{ I_xs1[e], I_ys1[e], I_zs1[e] };
-            if (foundIntersection1[e]) contactPoints.emplace_back(p);
+            if (foundIntersection1[e]) contactPoints.add(p);
         }
         for (size_t e = 2; e < 8; e++) {
             const glm::vec3 p{ I_xs2[e], I_ys2[e], I_zs2[e] };
-            if (foundIntersection2[e]) contactPoints.emplace_back(p);
+            if (foundIntersection2[e]) contactPoints.add(p);
         }
     }
 }
@@ -1525,7 +4636,7 @@ void HmlPhysics::findContactPointsBoxesAvxCompact(
 void HmlPhysics::findContactPointsBoxesAvxFastest(
         const std::array<glm::vec3, 2 * 8>& psPacked, // for A and B tightly packed
         const std::array<Object::Box::OrientationData, 2>& orientationDataPacked, // for A and B tightly packed
-        std::vector<glm::vec3>& contactPoints) noexcept {
+        ContactManifold& contactPoints) noexcept {
     // Output
     constexpr size_t TOTAL = 2 * 6 * 12; // both ways * faces * edges
     alignas(32) float foundIntersection[TOTAL];
@@ -1612,7 +4723,7 @@ void HmlPhysics::findContactPointsBoxesAvxFastest(
 
     // Process result
     for (size_t e = 0; e < TOTAL; e++) {
-        if (foundIntersection[e]) contactPoints.emplace_back(I_xs[e], I_ys[e], I_zs[e]);
+        if (foundIntersection[e]) contactPoints.add(glm::vec3{ I_xs[e], I_ys[e], I_zs[e] });
     }
 }
 
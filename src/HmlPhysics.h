@@ -13,10 +13,17 @@
 #include <bitset>
 #include <chrono>
 #include <span>
+#include <deque>
+#include <numeric>
+#include <bit>
+#include <algorithm>
 #include <immintrin.h>
 #include <atomic>
 #include <mutex>
 #include <thread>
+#include <memory>
+#include <type_traits>
+#include <cstring>
 
 #include "HmlMath.h"
 
@@ -75,20 +82,23 @@ class HmlPhysics {
         SameThread, SameThreadAndHelperThreads, AnotherThread, AnotherThreadAndHelperThreads
     } mode;
 
+    enum class Broadphase {
+        Grid, SweepAndPrune, AabbTree
+    } broadphase;
+
     struct Object {
         // ============================================================
         // ============== Member types
         // ============================================================
         enum class Type {
-            Sphere, Box
+            Sphere, Box, Heightfield
         };
 
+        // A generational handle, see HmlPhysics::ObjectIds
         using Id = uint32_t;
         inline static constexpr Id INVALID_ID = 0;
-        inline static Id generateId() noexcept {
-            static Id nextIdToUse = 1;
-            return nextIdToUse++;
-        }
+        using BodyIndex = uint32_t;
+        inline static constexpr BodyIndex INVALID_BODY_INDEX = std::numeric_limits<BodyIndex>::max();
 
         struct DynamicProperties {
             float mass = std::numeric_limits<float>::max();
@@ -97,6 +107,8 @@ class HmlPhysics {
             glm::mat3 rotationalInertiaTensor = glm::mat3(1);
             glm::mat3 invRotationalInertiaTensor = glm::mat3(0);
 
+            // NOTE These are the initial values only. Once the Object has been
+            // registered, the up-to-date state lives in HmlPhysics::bodies.
             glm::vec3 velocity = glm::vec3{0};
             glm::vec3 angularMomentum = glm::vec3{0};
 
@@ -115,20 +127,20 @@ class HmlPhysics {
         // Possibly stores redundant data, but this way we can generalize across all shapes.
         glm::vec3 position;
         std::array<float, 3> dimensions;
-        mutable std::optional<glm::mat4> modelMatrixCached;
+        // What the narrowphase reads for every pair is kept close together, right after the shape
+        Type type;
+        Id id;
+        BodyIndex bodyIndex = INVALID_BODY_INDEX; // into HmlPhysics::bodies; only for non-stationary
         glm::quat orientation = glm::quat(1, 0, 0, 0); // unit = quat(w, x, y, z)
         // glm::quat orientation = glm::rotate(glm::quat(1, 0, 0, 0), 1.0f, glm::vec3(0,0,1)); // unit = quat(w, x, y, z)
         std::optional<DynamicProperties> dynamicProperties = std::nullopt;
-        Type type;
-        Id id;
         // ============================================================
         // ============== Object
         // ============================================================
         inline Object(Type type) : type(type), id(INVALID_ID) {}
 
 
-        const glm::mat4& modelMatrix() const noexcept;
-        glm::mat4 generateModelMatrix() const noexcept;
+        glm::mat4 modelMatrix() const noexcept;
 
 
         struct AABB {
@@ -194,17 +206,99 @@ class HmlPhysics {
         bool isBox() const noexcept;
         Box& asBox() noexcept;
         const Box& asBox() const noexcept;
+        // ============================================================
+        // ============== Heightfield
+        // ============================================================
+        // Always stationary; the heights are kept by HmlPhysics (see registerHeightfield())
+        struct Heightfield {
+            glm::vec3 start; // y is unused
+            uint32_t gridIndex; // into HmlPhysics::heightGrids
+            float _stub1;
+            float _stub2;
+        };
+        static_assert(sizeof(Heightfield) == sizeof(position) + sizeof(dimensions) && "Please allocate larger dimensions[] in Object because Heightfield doesn't fit.");
+
+        bool isHeightfield() const noexcept;
+        Heightfield& asHeightfield() noexcept;
+        const Heightfield& asHeightfield() const noexcept;
+    };
+    // ============================================================
+    // ============= Heightfields
+    // ============================================================
+    // Heights sampled on a regular grid over the XZ plane. Each cell is split
+    // into two triangles along the diagonal from (x + 1, z) to (x, z + 1), the
+    // same way as the terrain is rendered (see Himmel::World::heightAtCoordWithT()).
+    struct HeightGrid {
+        glm::vec2 start; // (x, z) of the sample [0][0]
+        glm::vec2 cellSize;
+        size_t countX;
+        size_t countZ;
+        std::vector<float> heights; // countZ rows of countX samples
+
+        inline float at(size_t x, size_t z) const noexcept { return heights[z * countX + x]; }
+
+        // Inclusive; empty if first > last on either axis
+        struct CellRange {
+            int firstX, firstZ;
+            int lastX, lastZ;
+            inline bool empty() const noexcept { return firstX > lastX || firstZ > lastZ; }
+        };
+        // The cells under the XZ extent of the AABB
+        CellRange cellsUnder(const Object::AABB& aabb) const noexcept;
+    };
+    // ============================================================
+    // ============= Queries
+    // ============================================================
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 dir; // normalized
+        float maxDistance = std::numeric_limits<float>::max();
+    };
+    struct RayHit {
+        Object::Id id = Object::INVALID_ID; // if nothing was hit
+        float distance = 0.0f;
+        glm::vec3 normal = glm::vec3{0};
+    };
+    struct OverlapHit {
+        uint32_t shapeIndex; // into the queried shapes
+        Object::Id id;
     };
     // ============================================================
     // ============= Collisions
     // ============================================================
     private:
 
+    // Contact points stored inline. Once full, it is reduced to the 4 points
+    // that span the largest area, so a Box face resting on another keeps its corners.
+    struct ContactManifold {
+        static constexpr size_t CAPACITY = 8;
+        static constexpr size_t REDUCED = 4;
+
+        inline ContactManifold() noexcept : count(0) {}
+        inline ContactManifold(std::initializer_list<glm::vec3> list) noexcept : count(0) {
+            for (const auto& p : list) add(p);
+        }
+
+        void add(const glm::vec3& p) noexcept;
+        void reduce() noexcept;
+        inline void clear() noexcept { count = 0; }
+
+        inline size_t size() const noexcept { return count; }
+        inline bool empty() const noexcept { return count == 0; }
+        inline const glm::vec3* begin() const noexcept { return points.data(); }
+        inline const glm::vec3* end()   const noexcept { return points.data() + count; }
+
+        private:
+        std::array<glm::vec3, CAPACITY> points;
+        size_t count;
+    };
+
     struct Detection {
         glm::vec3 dir;
         float extent;
-        std::vector<glm::vec3> contactPoints;
+        ContactManifold contactPoints;
     };
+    static_assert(std::is_trivially_copyable_v<Detection>);
 
     static std::optional<Detection> detectAxisAlignedBoxSphere(const Object::Box& b, const Object::Sphere& s) noexcept;
     static std::optional<Detection> detectOrientedBoxSphere(const Object::Box& b, const Object::Sphere& s) noexcept;
@@ -215,27 +309,8 @@ class HmlPhysics {
     template<typename Arg1, typename Arg2>
     static std::optional<Detection> detect(const Arg1& arg1, const Arg2& arg2) noexcept;
 
-    struct ObjectAdjustment {
-        // NOTE storing idOther ensures that interactions with multiple objects for a single object are recorded
-        Object::Id id             = Object::INVALID_ID;
-        Object::Id idOther        = Object::INVALID_ID;
-        glm::vec3 position        = glm::vec3(0.0f);
-        glm::vec3 velocity        = glm::vec3(0.0f);
-        glm::vec3 angularMomentum = glm::vec3(0.0f);
-    };
-    struct ObjectAdjustmentHasher {
-        inline size_t operator()(const ObjectAdjustment& objectAdjustment) const {
-            return std::hash<Object::Id>{}(objectAdjustment.id);
-        }
-    };
-    struct ObjectAdjustmentEqual {
-        inline size_t operator()(const ObjectAdjustment& objAdj1, const ObjectAdjustment& objAdj2) const {
-            return objAdj1.id == objAdj2.id && objAdj1.idOther == objAdj2.idOther;
-        }
-    };
-
-    using ProcessResult = std::pair<ObjectAdjustment, ObjectAdjustment>;
-    static ProcessResult process(const Object& obj1, const Object& obj2) noexcept;
+    // Picks the detector for the shapes; dir is from obj1 towards obj2
+    static std::optional<Detection> detectPair(const Object& obj1, const Object& obj2) noexcept;
     // ========================================================================
     struct Simplex {
         inline Simplex() noexcept : points({ glm::vec3{0}, glm::vec3{0}, glm::vec3{0}, glm::vec3{0} }), count(0) {}
@@ -264,72 +339,304 @@ class HmlPhysics {
         size_t count;
     };
 
+    // The expanding polytope of EPA. Fixed capacity, so that a query never
+    // touches the heap; it lives on the stack of the thread that runs it.
+    struct Polytope {
+        static constexpr size_t MAX_POINTS = 64;
+        static constexpr size_t MAX_FACES  = 2 * MAX_POINTS;
+        static constexpr size_t MAX_EDGES  = MAX_FACES;
+        using Face = std::array<uint8_t, 3>; // into points, counter-clockwise when seen from outside
+        using Edge = std::pair<uint8_t, uint8_t>;
+
+        std::array<glm::vec3, MAX_POINTS> points;
+        std::array<Face, MAX_FACES> faces;
+        std::array<glm::vec4, MAX_FACES> normals; // (outward normal, distance to the origin)
+        std::array<Edge, MAX_EDGES> edges; // the horizon while expanding
+        size_t pointCount = 0;
+        size_t faceCount = 0;
+        size_t edgeCount = 0;
+
+        // Fixes the winding so that the normal points away from the origin
+        void addFace(uint8_t a, uint8_t b, uint8_t c) noexcept;
+        void removeFace(size_t f) noexcept;
+        // Removes the edge if its reverse is already there (it is shared by two removed faces)
+        bool addUniqueEdge(uint8_t a, uint8_t b) noexcept;
+        size_t closestFace() const noexcept;
+    };
+    static constexpr size_t GJK_MAX_ITERATIONS = 32;
+    static constexpr size_t EPA_MAX_ITERATIONS = 32;
+
+    // The vertices of a convex shape in SoA, padded to a multiple of 8 (with
+    // copies of the first vertex), so that the support point is found with AVX
+    struct ConvexVertices {
+        static constexpr size_t MAX_CHUNKS = 4; // of 8 vertices each
+        alignas(32) std::array<float, 8 * MAX_CHUNKS> xs;
+        alignas(32) std::array<float, 8 * MAX_CHUNKS> ys;
+        alignas(32) std::array<float, 8 * MAX_CHUNKS> zs;
+        size_t chunks;
+
+        explicit ConvexVertices(std::span<const glm::vec3> ps) noexcept;
+        static ConvexVertices ofBox(const Object::Box& box) noexcept;
+        glm::vec3 furthestPointInDir(const glm::vec3& dir) const noexcept;
+    };
     static glm::vec3 furthestPointInDir(const glm::vec3& dir, std::span<const glm::vec3> ps) noexcept;
     static glm::vec3 calcSupport(const glm::vec3& dir, std::span<const glm::vec3> ps1, std::span<const glm::vec3> ps2) noexcept;
+    static glm::vec3 calcSupport(const glm::vec3& dir, const ConvexVertices& vs1, const ConvexVertices& vs2) noexcept;
     static std::optional<Detection> gjk(const Object::Box& b1, const Object::Box& b2) noexcept;
     static std::optional<Detection> epa(const Simplex& simplex, const auto& ps1, const auto& ps2) noexcept;
     // ========================================================================
     struct Bucket {
-        inline static constexpr float SIZE = 8.0f;
-
         using Coord = int16_t;
+        using Level = uint8_t;
         using Hash = uint64_t;
-        using Bounding = std::pair<Bucket, Bucket>;
+        using Bounding = std::pair<Bucket, Bucket>; // both of the same level
 
         Coord x;
         Coord y;
         Coord z;
+        Level level = 0; // of GridLevels
 
         friend auto operator<=>(const Bucket&, const Bucket&) = default;
 
-        inline static Bucket fromPos(const glm::vec3& pos) noexcept {
+        inline Hash packed() const noexcept {
+            return (static_cast<Hash>(level) << 48) |
+                   (static_cast<Hash>(static_cast<uint16_t>(x)) << 32) |
+                   (static_cast<Hash>(static_cast<uint16_t>(y)) << 16) |
+                    static_cast<Hash>(static_cast<uint16_t>(z));
+        }
+
+        // The Bucket levels up that contains this one; the cells of each level nest in those of the next
+        inline Bucket coarser(Level levels) const noexcept {
             return Bucket{
-                .x = toCoord(pos.x),
-                .y = toCoord(pos.y),
-                .z = toCoord(pos.z),
+                .x = static_cast<Coord>(x >> levels),
+                .y = static_cast<Coord>(y >> levels),
+                .z = static_cast<Coord>(z >> levels),
+                .level = static_cast<Level>(level + levels),
             };
         }
 
-        inline static Coord toCoord(float x) noexcept {
-            return static_cast<Coord>(std::floor(x / SIZE));
+        inline static Coord toCoord(float x, float cellSize) noexcept {
+            return static_cast<Coord>(std::floor(x / cellSize));
         }
 
         inline bool isInsideBoundingBuckets(const Bounding& bounding) const noexcept {
-            return (bounding.first.x <= x && x <= bounding.second.x &&
+            return (bounding.first.level == level &&
+                    bounding.first.x <= x && x <= bounding.second.x &&
                     bounding.first.y <= y && y <= bounding.second.y &&
                     bounding.first.z <= z && z <= bounding.second.z);
         }
     };
 
-    struct BucketHasher {
-        inline size_t operator()(const Bucket& bucket) const {
-            const HmlPhysics::Bucket::Hash comb =
-                (static_cast<uint64_t>(static_cast<uint16_t>(bucket.x)) << 32) |
-                (static_cast<uint64_t>(static_cast<uint16_t>(bucket.y)) << 16) |
-                 static_cast<uint64_t>(static_cast<uint16_t>(bucket.z));
-            return std::hash<HmlPhysics::Bucket::Hash>{}(comb);
+    // The Bucket grid is a hierarchy of levels, the cells of each twice as
+    // large as those of the previous one. An Object goes into the finest level
+    // whose cells are at least as large as its AABB, so it is in at most
+    // 2x2x2 Buckets there (unless it outgrows even the coarsest level) and
+    // shares them only with Objects of about its size. Pairs across levels are
+    // found by the finer Object looking up the Buckets of the coarser levels.
+    struct GridLevels {
+        inline static constexpr Bucket::Level MAX_COUNT = 16;
+
+        float finestCellSize = 8.0f;
+        Bucket::Level count = 5;
+
+        inline float cellSize(Bucket::Level level) const noexcept { return finestCellSize * static_cast<float>(1u << level); }
+        Bucket::Level levelFor(const Object::AABB& aabb) const noexcept;
+        inline Bucket bucketAt(const glm::vec3& pos, Bucket::Level level) const noexcept {
+            const float size = cellSize(level);
+            return Bucket{
+                .x = Bucket::toCoord(pos.x, size),
+                .y = Bucket::toCoord(pos.y, size),
+                .z = Bucket::toCoord(pos.z, size),
+                .level = level,
+            };
+        }
+    } gridLevels;
+
+    // Maps each Bucket to the Objects in it. Bucket membership is rebuilt
+    // every step with a counting sort: the first pass finds (or inserts) the
+    // slot of every (Bucket, Object) entry in a flat open-addressing table and
+    // counts the entries per slot, the second pass scatters the Objects into a
+    // single contiguous array, grouped by slot.
+    // NOTE The keys are kept between steps, because the set of occupied Buckets
+    // barely changes; slots may thus be empty. The entries of stationary Objects
+    // are also kept, as they never change, and so are those of the Bodies that
+    // have stayed in the same Buckets. All are only recomputed on a full
+    // rebuild, which happens when the table gets too crowded.
+    struct BucketTable {
+        inline static constexpr Bucket::Hash EMPTY_KEY = std::numeric_limits<Bucket::Hash>::max(); // not a valid key
+
+        struct Slot {
+            Bucket::Hash key = EMPTY_KEY;
+            Bucket bucket;
+            uint32_t begin = 0; // into objectIndices
+            uint32_t count = 0;
+        };
+        std::vector<Slot> slots; // size is a power of 2
+        std::vector<uint32_t> usedSlots; // in the order of first use
+        size_t nonEmptySlotCount = 0; // of usedSlots, as of the last rebuild
+        std::vector<uint32_t> objectIndices; // of all used Slots, back to back
+
+        struct Entry {
+            uint32_t slot;
+            uint32_t objectIndex;
+        };
+        std::vector<Entry> entries; // of the dynamic Objects, grouped by Body
+        std::vector<Entry> previousEntries;
+        std::vector<uint32_t> entryBeginOfBody; // into entries, as of the last rebuild; plus the end
+        std::vector<uint32_t> previousEntryBeginOfBody;
+        std::vector<Entry> staticEntries;
+        std::vector<uint32_t> staticObjectIndices;
+        std::vector<Object::BodyIndex> movedBodies; // with a new Bounding since the last rebuild; may repeat
+        bool needsFullRebuild = true;
+        bool staticEntriesChanged = false; // by a removal since the last rebuild
+        // As of the last rebuild; lets the lookups skip the empty levels
+        std::array<uint32_t, GridLevels::MAX_COUNT> entryCountOfLevel{};
+        std::array<uint32_t, GridLevels::MAX_COUNT> dynamicEntryCountOfLevel{};
+
+        inline void addStatic(uint32_t objectIndex) noexcept {
+            staticObjectIndices.push_back(objectIndex);
+            needsFullRebuild = true;
         }
+        // Edit the static entries in place, which is cheaper than a full rebuild
+        void removeStatic(uint32_t objectIndex) noexcept;
+        void renameStatic(uint32_t fromObjectIndex, uint32_t toObjectIndex) noexcept;
+        // boundings has an entry for each Object (same indexing)
+        void rebuild(std::span<const Bucket::Bounding> boundings, std::span<const size_t> dynamicObjectIndices) noexcept;
+        void addEntries(uint32_t objectIndex, const Bucket::Bounding& bounding, std::vector<Entry>& dst) noexcept;
+        uint32_t findOrInsertSlot(const Bucket& bucket) noexcept;
+        const Slot* findSlot(const Bucket& bucket) const noexcept;
+        // Where the search for the key starts in a table of size mask + 1
+        inline static size_t firstSlotIndex(Bucket::Hash key, size_t mask) noexcept {
+            // Fibonacci hashing spreads the neighboring keys apart; the top bits are the best mixed
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        }
+        inline std::span<const uint32_t> objectIndicesIn(const Slot& slot) const noexcept {
+            return std::span<const uint32_t>(objectIndices.data() + slot.begin, slot.count);
+        }
+    } bucketTable;
+
+    Bucket::Bounding boundingBucketsForAabb(const Object::AABB& aabb) const noexcept;
+    // All Objects get new Buckets on the next rebuild
+    void internalSetGridLevels(const GridLevels& levels) noexcept;
+    // Bodies that have left some of their Buckets or entered new ones, found
+    // in parallel by updateShapes() and applied in the order of Bodies
+    struct BucketMove {
+        Object::BodyIndex bodyIndex;
+        Bucket::Bounding bounding;
     };
-
-    // NOTE can contain Buckets not present in any of the inputs
-    static Bucket::Bounding boundingBucketsSum(const Bucket::Bounding& bb1, const Bucket::Bounding& bb2) noexcept;
-    static Bucket::Bounding boundingBucketsForObject(const Object& object) noexcept;
+    void applyBucketMoves() noexcept;
+    void reassignBuckets() noexcept;
+    // ========================================================================
+    // ============== Queries
+    // ========================================================================
+    // What the queries see: the shapes of all Objects (SoA, so that 8 rays can
+    // be tested against one at a time) and a compact copy of the Bucket grid
+    // over them, as of the end of a step. A snapshot never changes once
+    // published, so any number of threads can query it while the physics
+    // thread works on the next step. Snapshots no one holds anymore get reused.
+    // NOTE The Buckets are the ones the Objects were assigned to during the
+    // step, so the solver may have moved an Object a bit out of them.
+    struct QuerySnapshot {
+        std::vector<Object::Id> ids;
+        std::vector<Object::Type> types;
+        std::vector<float> centerXs, centerYs, centerZs;
+        std::vector<float> halfXs, halfYs, halfZs; // the radius (in halfXs) for Spheres
+        std::vector<glm::quat> orientations;
+        std::vector<BucketTable::Slot> slots; // only the used ones of bucketTable; size is a power of 2
+        std::vector<uint32_t> objectIndices; // of all slots, back to back
+        GridLevels levels;
+        std::array<Object::AABB, GridLevels::MAX_COUNT> boundsOfLevel; // of the used Buckets of each level; empty if none
+
+        inline size_t size() const noexcept { return ids.size(); }
+        const BucketTable::Slot* findSlot(const Bucket& bucket) const noexcept;
+        // A stationary copy of the Object, for the narrowphase detectors
+        Object objectAt(uint32_t objectIndex) const noexcept;
+        // Calls func(slot) for every used Bucket along the ray, stepping from one to the next (DDA), level by level
+        template<typename F>
+        void forEachSlotAlong(const Ray& ray, const F& func) const noexcept;
+        template<typename F>
+        void forEachSlotAlong(const Ray& ray, Bucket::Level level, const F& func) const noexcept;
+        // Tests 8 rays (padded with ones that can't hit) against every candidate with AVX
+        void raycastPacket(std::span<const Ray> rays, std::span<RayHit> hits, std::span<const uint32_t> candidates) const noexcept;
+        void raycast(std::span<const Ray> rays, std::span<RayHit> hits) const noexcept;
+        void overlap(std::span<const Object> shapes, std::vector<OverlapHit>& hits) const noexcept;
+    };
+    std::vector<std::shared_ptr<QuerySnapshot>> querySnapshots; // owned by the physics thread, for reuse
+    std::atomic<std::shared_ptr<const QuerySnapshot>> latestQuerySnapshot; // null until the first step
+    void publishQuerySnapshot() noexcept;
     void checkForAndHandleCollisions() noexcept;
-    void removeObjectWithIdFromBucket(Object::Id id, const Bucket& bucket) noexcept;
     // ========================================================================
     ctpl::thread_pool threadPool;
-    std::vector<Bucket::Bounding> allBoundingBucketsBefore; // for each non-stationary object; from previous frame
+    size_t workers = 1; // the helper threads, or the calling thread if there are none
+    inline size_t workerCount() const noexcept { return workers; }
+    // Runs func(task, worker) for every task in [0, taskCount), with worker in
+    // [0, workerCount()). Each worker starts off with an equal contiguous range
+    // of tasks and takes them from its front; once it runs out, it steals the
+    // back half of the largest remaining range. Tasks should thus be small.
+    template<typename F>
+    void runTasks(size_t taskCount, const F& func) noexcept;
+    // [begin, end) of the tasks left to a worker, packed into a single word so
+    // that both the worker and the thieves can update it atomically
+    struct alignas(64) TaskRange {
+        std::atomic<uint64_t> beginEnd;
+    };
+    std::unique_ptr<TaskRange[]> taskRanges; // one per worker
+    std::vector<Bucket::Bounding> allBoundingBuckets; // for each Object (same indexing); as currently registered in bucketTable
+
+    struct SolverSettings { // see Contact solver
+        int velocityIterations = 8;
+        int positionIterations = 3;
+    };
+    // ========================================================================
+    // ============== Commands
+    // ========================================================================
+    // Mutations requested from the outside world. With a self thread they are
+    // queued and executed at the start of the next step; otherwise right away.
+    struct Command {
+        enum class Type {
+            Register, Remove, ApplyImpulse, SetVelocity, SetTransform, SetGridLevels, SetSolverIterations
+        } type;
+        Object::Id id = Object::INVALID_ID; // of the target Object; unused for Register
+        glm::vec3 vector = glm::vec3{0}; // impulse, velocity or position
+        glm::quat orientation = glm::quat(1, 0, 0, 0); // for SetTransform
+        std::optional<Object> object = std::nullopt; // for Register
+        std::unique_ptr<HeightGrid> heightGrid = nullptr; // for Register of a Heightfield
+        std::optional<GridLevels> gridLevels = std::nullopt; // for SetGridLevels
+        std::optional<SolverSettings> solverSettings = std::nullopt; // for SetSolverIterations
+    };
+    // Bounded lock-free queue with many producers and the physics thread as
+    // the only consumer. Every cell carries a sequence number that tells
+    // whether it is free for the producer at that position or ready for the
+    // consumer.
+    struct CommandRing {
+        inline static constexpr size_t CAPACITY = 1024; // power of 2
+        inline static constexpr size_t MASK = CAPACITY - 1;
+        struct Cell {
+            std::atomic<size_t> sequence;
+            Command command;
+        };
+        std::unique_ptr<Cell[]> cells;
+        alignas(64) std::atomic<size_t> enqueuePosition = 0;
+        alignas(64) size_t dequeuePosition = 0; // owned by the consumer
+
+        CommandRing() noexcept;
+        // Moves from command only on success, fails if the ring is full
+        bool tryPush(Command& command) noexcept;
+        bool tryPop(Command& command) noexcept;
+    };
 
     struct ThreadedData {
         static constexpr float MAX_ALLOWED_LAG_SECONDS = 0.05f;
         std::atomic<float> accumulatedDt = 0.0f;
 
-        std::vector<Object> objectsToRegister;
-        std::mutex objectsToRegisterMutex;
-        std::atomic<bool> hasNewObjectsToRegister = false;
-
-        std::vector<std::pair<Object::Id, glm::mat4>> modelMatrices;
-        std::mutex modelMatricesMutex;
+        CommandRing commands;
+        // Once the ring has overflowed, all new Commands go here (to keep their
+        // order) until the physics thread catches up
+        std::vector<Command> overflowCommands;
+        std::vector<Command> drainedOverflowCommands; // owned by the physics thread
+        std::mutex overflowCommandsMutex;
+        std::atomic<bool> overflowing = false;
+        std::atomic<bool> hasPendingCommands = false;
 
         std::atomic<bool> terminate = false;
         int substeps = 1;
@@ -337,18 +644,572 @@ class HmlPhysics {
 
     std::thread thread;
 
+    // Publishes the model matrices of the last step to a single reader without
+    // either side ever blocking. The writer fills the back slot and swaps it
+    // with the middle one; the reader swaps its front slot with the middle one
+    // if that is newer. The slots keep their capacity, so nothing is allocated
+    // once the number of Objects stops growing.
+    struct ModelMatricesTripleBuffer {
+        using Slot = std::vector<std::pair<Object::Id, glm::mat4>>;
+        inline static constexpr uint8_t INDEX_MASK = 0b011;
+        inline static constexpr uint8_t FRESH_BIT  = 0b100;
+
+        std::array<Slot, 3> slots;
+        uint8_t backIndex  = 0; // owned by the writer
+        uint8_t frontIndex = 1; // owned by the reader
+        std::atomic<uint8_t> middle = 2; // | FRESH_BIT if not yet seen by the reader
+
+        inline Slot& back() noexcept { return slots[backIndex]; }
+        void publish() noexcept;
+        const Slot& latest() noexcept;
+    } modelMatrices;
+    void publishModelMatrices() noexcept;
+
     struct ThreadedStats {
         int substeps;
     };
 
+    // Of the last step
+    struct StepStats {
+        float integrationMicros = 0.0f;
+        float broadphaseMicros  = 0.0f;
+        float narrowphaseMicros = 0.0f;
+        float solverMicros      = 0.0f;
+        size_t candidatePairs   = 0;
+        size_t awakeBodies      = 0;
+        size_t sweptBodies      = 0;
+    } stepStats; // owned by the physics thread
+    // Publishes stepStats after each step to any number of readers (a
+    // seqlock): a reader retries if a step ends while it copies. The words
+    // are atomics, so that the copies torn that way are not data races.
+    struct StepStatsSeqlock {
+        inline static constexpr size_t WORD_COUNT = (sizeof(StepStats) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> sequence = 0; // odd while the writer copies
+        std::array<std::atomic<uint64_t>, WORD_COUNT> words{};
+
+        void publish(const StepStats& stats) noexcept;
+        StepStats latest() const noexcept;
+    } publishedStepStats;
+
     glm::vec3 gravity = glm::vec3{0, -9.8f, 0};
 
+    // ========================================================================
+    // ============== Bodies
+    // ========================================================================
+    // The state of non-stationary Objects that changes every step, stored as
+    // SoA so that integration can advance 8 bodies at a time with AVX. Each
+    // array is padded to a multiple of LANES; the padding lanes hold a valid
+    // (identity) state and are never written back. Stationary Objects never
+    // move and so have no Body.
+    struct Bodies {
+        using Array = std::vector<float, hml::AlignedAllocator<float, 32>>;
+        inline static constexpr size_t LANES = 8;
+
+        Array positionXs, positionYs, positionZs;
+        Array velocityXs, velocityYs, velocityZs;
+        Array orientationWs, orientationXs, orientationYs, orientationZs;
+        Array angularMomentumXs, angularMomentumYs, angularMomentumZs;
+        // Diagonal of the body-space inverse rotational inertia tensor
+        // (all supported shapes have a diagonal one)
+        Array invInertiaXs, invInertiaYs, invInertiaZs;
+        // World-space inverse rotational inertia tensor; symmetric, so only 6 elements are stored
+        Array invInertiaWorldXXs, invInertiaWorldXYs, invInertiaWorldXZs;
+        Array invInertiaWorldYYs, invInertiaWorldYZs, invInertiaWorldZZs;
+        // Radius of the largest sphere around the center that fits into the shape
+        Array sweptRadii;
+        // All bits set for awake bodies; zero for sleeping ones and the padding
+        Array awakeMasks;
+        // For how many steps in a row the body has been slow enough to sleep
+        std::vector<uint32_t> sleepCounters;
+
+        std::vector<size_t> objectIndices; // into HmlPhysics::objects
+
+        inline size_t size()       const noexcept { return objectIndices.size(); }
+        inline size_t paddedSize() const noexcept { return positionXs.size(); }
+
+        static const std::array<Array Bodies::*, 24> ALL_ARRAYS;
+        Object::BodyIndex push(const Object& object, size_t objectIndex) noexcept;
+        // Moves the last Body into i (so its Object has to be told) and drops the padding left empty
+        void remove(size_t i) noexcept;
+
+        inline bool isAwake(size_t i) const noexcept { return std::bit_cast<uint32_t>(awakeMasks[i]) != 0; }
+        inline void setAwake(size_t i, bool awake) noexcept { awakeMasks[i] = std::bit_cast<float>(awake ? 0xFFFFFFFFu : 0u); }
+
+        inline glm::vec3 velocity(size_t i) const noexcept {
+            return glm::vec3{ velocityXs[i], velocityYs[i], velocityZs[i] };
+        }
+        inline glm::vec3 angularMomentum(size_t i) const noexcept {
+            return glm::vec3{ angularMomentumXs[i], angularMomentumYs[i], angularMomentumZs[i] };
+        }
+        inline void addPosition(size_t i, const glm::vec3& delta) noexcept {
+            positionXs[i] += delta.x; positionYs[i] += delta.y; positionZs[i] += delta.z;
+        }
+        inline void addVelocity(size_t i, const glm::vec3& delta) noexcept {
+            velocityXs[i] += delta.x; velocityYs[i] += delta.y; velocityZs[i] += delta.z;
+        }
+        inline void setPosition(size_t i, const glm::vec3& position) noexcept {
+            positionXs[i] = position.x; positionYs[i] = position.y; positionZs[i] = position.z;
+        }
+        inline void setVelocity(size_t i, const glm::vec3& velocity) noexcept {
+            velocityXs[i] = velocity.x; velocityYs[i] = velocity.y; velocityZs[i] = velocity.z;
+        }
+        inline void setOrientation(size_t i, const glm::quat& orientation) noexcept {
+            orientationWs[i] = orientation.w; orientationXs[i] = orientation.x;
+            orientationYs[i] = orientation.y; orientationZs[i] = orientation.z;
+        }
+        inline void addAngularMomentum(size_t i, const glm::vec3& delta) noexcept {
+            angularMomentumXs[i] += delta.x; angularMomentumYs[i] += delta.y; angularMomentumZs[i] += delta.z;
+        }
+        // The world-space inverse rotational inertia tensor times v
+        inline glm::vec3 invInertiaWorldTimes(size_t i, const glm::vec3& v) const noexcept {
+            return glm::vec3{
+                invInertiaWorldXXs[i] * v.x + invInertiaWorldXYs[i] * v.y + invInertiaWorldXZs[i] * v.z,
+                invInertiaWorldXYs[i] * v.x + invInertiaWorldYYs[i] * v.y + invInertiaWorldYZs[i] * v.z,
+                invInertiaWorldXZs[i] * v.x + invInertiaWorldYZs[i] * v.y + invInertiaWorldZZs[i] * v.z,
+            };
+        }
+        inline glm::vec3 angularVelocity(size_t i) const noexcept { return invInertiaWorldTimes(i, angularMomentum(i)); }
+        inline glm::mat3 invInertiaWorld(size_t i) const noexcept {
+            return glm::mat3(
+                invInertiaWorldXXs[i], invInertiaWorldXYs[i], invInertiaWorldXZs[i],
+                invInertiaWorldXYs[i], invInertiaWorldYYs[i], invInertiaWorldYZs[i],
+                invInertiaWorldXZs[i], invInertiaWorldYZs[i], invInertiaWorldZZs[i]);
+        }
+    } bodies;
+
+    struct FastBody; // see Continuous collision detection
+    // Advances bodies [begin, end) by dt, writes the new position and
+    // orientation back into their Objects and adds the fast ones to fast.
+    // begin and end must be multiples of LANES.
+    void integrateBodies(float dt, size_t begin, size_t end, std::vector<FastBody>& fast) noexcept;
+    // All bodies, in parallel ranges; fastBodies get merged in the order of Bodies
+    void integrate(float dt) noexcept;
+    // ========================================================================
+    // ============== Shapes
+    // ========================================================================
+    // What the broadphase and the narrowphase read of each Object, derived
+    // from its position and orientation once per step rather than once per
+    // pair. Indexed by Object (like allBoundingBuckets). Computed on
+    // registration for all Objects and after integration for the awake Bodies,
+    // so the solver moving the Bodies afterwards leaves it a step behind
+    // (except for the Bodies that fall asleep, which get theirs again then).
+    struct Shapes {
+        // 8 corners per Object (of Boxes; other shapes repeat their center), in
+        // the order of Box::toPoints(); each coordinate occupies one aligned
+        // group of LANES, so that all the corners of a Box load as one vec3_256
+        Bodies::Array cornerXs, cornerYs, cornerZs;
+        std::vector<Object::Box::OrientationData> axes; // normalized
+        std::vector<Object::AABB> aabbs;
+
+        void push(const Object& object) noexcept;
+        void update(size_t objectIndex, const Object& object) noexcept;
+        // Moves the last Object's into objectIndex
+        void remove(size_t objectIndex) noexcept;
+
+        inline hml::vec3_256 corners(size_t objectIndex) const noexcept {
+            const size_t offset = objectIndex * Bodies::LANES;
+            return hml::vec3_256(&cornerXs[offset], &cornerYs[offset], &cornerZs[offset]);
+        }
+        // AoS xyz, as Box::toPointsAt() writes them
+        void cornersAt(size_t objectIndex, float* ptr) const noexcept;
+    } shapes;
+    void updateShapes() noexcept;
+    // ========================================================================
+    // ============== Continuous collision detection
+    // ========================================================================
+    // A Body that moves further than CCD_MOTION_FRACTION of its swept radius
+    // in a single step could pass (at least halfway) through a thin Object
+    // between two discrete tests. Such Bodies are picked out during integration. Afterwards the
+    // sphere of the swept radius is swept along their motion (rotation is
+    // ignored) against the Objects in the way. On a hit the Body is moved
+    // back to where it just sinks into the first of them, so that the
+    // narrowphase and the solver take it from there as a regular contact.
+    inline static constexpr float CCD_MOTION_FRACTION = 1.0f;
+    struct FastBody {
+        Object::BodyIndex bodyIndex;
+        glm::vec3 startPosition; // before the integration
+    };
+    std::vector<FastBody> fastBodies; // of the last integration; by bodyIndex
+    struct SweepHit {
+        float t; // along the motion, in [0, 1]
+        glm::vec3 normal; // of the surface that was hit
+    };
+    // Boxes are inflated by radius, rounded edges and corners aside
+    static std::optional<SweepHit> sweepSphere(const glm::vec3& start, const glm::vec3& finish,
+        float radius, const Object& object) noexcept;
+    // The candidates are looked up in bucketTable, around the motion
+    void sweepFastBodies() noexcept;
+    std::vector<uint32_t> sweepCandidates; // of the Body being swept
+
     std::vector<Object> objects;
-    std::unordered_map<Object::Id, size_t> objectIndexFromId;
-    std::unordered_map<Bucket, std::vector<Object::Id>, BucketHasher> objectsInBuckets;
+    // ========================================================================
+    // ============== Ids
+    // ========================================================================
+    // An Id is a slot in the low SLOT_BITS and the generation of the slot in
+    // the rest. The slot maps to wherever the Object currently is in objects
+    // (removals move the last Object into the hole), and the generation is
+    // advanced every time the slot is reused, so a stale Id of a removed
+    // Object never reaches the one that has replaced it.
+    // Ids are allocated by the registering thread, as registration returns
+    // the Id right away, but only released by the physics thread once the
+    // removal has been done, so that the Commands in between still find it.
+    struct ObjectIds {
+        inline static constexpr uint32_t SLOT_BITS = 24;
+        inline static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+        inline static constexpr uint32_t NO_OBJECT_INDEX = std::numeric_limits<uint32_t>::max();
+
+        std::mutex mutex;
+        std::vector<Object::Id> releasedIds; // with the generation already advanced
+        uint32_t nextSlot = 0;
+
+        inline static uint32_t slotOf(Object::Id id) noexcept { return id & SLOT_MASK; }
+        Object::Id allocate() noexcept;
+        void release(Object::Id id) noexcept;
+    } objectIds;
+    std::vector<uint32_t> objectIndexOfIdSlot; // owned by the physics thread; NO_OBJECT_INDEX if released
+    // NO_OBJECT_INDEX if the Object has been removed (or is yet to be registered)
+    uint32_t objectIndexOf(Object::Id id) const noexcept;
+    void setObjectIndexOf(Object::Id id, uint32_t objectIndex) noexcept;
 
-    using Adjustments = std::unordered_set<ObjectAdjustment, ObjectAdjustmentHasher, ObjectAdjustmentEqual>;
-    Adjustments adjustments;
+    // ========================================================================
+    // ============== Islands and sleeping
+    // ========================================================================
+    // Bodies that have been slow for SLEEP_STEPS steps in a row fall asleep,
+    // but only together with all the bodies they are (transitively) touching.
+    // A sleeping body is neither integrated nor moved between Buckets, and its
+    // pairs are skipped unless the other body is awake. It wakes up along with
+    // its whole island once an awake body touches it or it gets an impulse.
+    inline static constexpr uint32_t SLEEP_STEPS = 60;
+    inline static constexpr float SLEEP_LINEAR_VELOCITY = 0.5f;
+    inline static constexpr float SLEEP_ANGULAR_VELOCITY = 0.5f;
+    inline static constexpr uint32_t NO_ISLAND = std::numeric_limits<uint32_t>::max();
+
+    using BodyPair = std::pair<Object::BodyIndex, Object::BodyIndex>;
+    std::vector<std::vector<BodyPair>> workerContacts; // one per worker; found during the last narrowphase
+    std::vector<Object::BodyIndex> islandParents; // union-find forest over all Bodies
+    std::vector<uint32_t> islandMinSleepCounters; // for each root in islandParents
+    std::vector<uint32_t> sleepingIslandOfBody; // for each Body; NO_ISLAND while awake
+    std::vector<std::vector<Object::BodyIndex>> sleepingIslands;
+    std::vector<uint32_t> freeSleepingIslands;
+
+    inline bool isAwake(const Object& object) const noexcept {
+        return !object.isStationary() && bodies.isAwake(object.bodyIndex);
+    }
+    Object::BodyIndex findIslandRoot(Object::BodyIndex body) noexcept;
+    void wakeIsland(uint32_t sleepingIsland) noexcept;
+    // The islands of the sleeping bodies that could be resting on something within aabb
+    void wakeIslandsTouching(const Object::AABB& aabb) noexcept;
+    // Joins the bodies that touched during the last narrowphase into islands,
+    // wakes up the sleeping ones that got touched and puts the resting islands to sleep
+    void updateIslands() noexcept;
+    // Brings the Shapes and the Buckets (or the broadphase) of a Body that is
+    // falling asleep up to where the solver has left it, as nothing updates
+    // them while it sleeps
+    void updateShapeOfSleepingBody(Object::BodyIndex bodyIndex) noexcept;
+    // ========================================================================
+    // ============== Candidate pairs
+    // ========================================================================
+    using ObjectIndexPair = std::pair<uint32_t, uint32_t>; // into objects
+    // ========================================================================
+    // ============== Batched narrowphase
+    // ========================================================================
+    // Pairs are not processed one by one, but are grouped by the combination
+    // of shapes and tested 8 at a time with AVX. Each intersecting pair
+    // produces a single contact with up to ContactManifold::REDUCED points.
+    struct Contacts {
+        // Per pair
+        std::vector<ObjectIndexPair> pairs; // dir is from the first towards the second
+        std::vector<float> dirXs, dirYs, dirZs;
+        std::vector<float> extents;
+        std::vector<uint32_t> pointEnds; // the points of pair i are [pointEnds[i - 1], pointEnds[i])
+        // Per contact point
+        std::vector<float> pointXs, pointYs, pointZs;
+
+        inline size_t size() const noexcept { return pairs.size(); }
+        inline uint32_t pointBegin(size_t i) const noexcept { return (i == 0) ? 0 : pointEnds[i - 1]; }
+        void clear() noexcept;
+        void push(const ObjectIndexPair& pair, const glm::vec3& dir, float extent, ContactManifold points) noexcept;
+        // Appends the lanes of the 8 results that are set in hitLanes
+        void pushLanes(const ObjectIndexPair* lanePairs, int hitLanes,
+            const hml::vec3_256& dir, __m256 extent, const hml::vec3_256& point) noexcept;
+    };
+    struct NarrowphaseBatch {
+        std::vector<ObjectIndexPair> sphereSpherePairs;
+        std::vector<ObjectIndexPair> boxSpherePairs; // the Box goes first
+        std::vector<ObjectIndexPair> boxBoxPairs;
+        Contacts contacts;
+    };
+    std::vector<NarrowphaseBatch> narrowphaseBatches; // one per worker
+    // What the parallel stages before the broadphase found, merged afterwards
+    struct WorkerEvents {
+        std::vector<FastBody> fastBodies;
+        std::vector<BucketMove> bucketMoves;
+    };
+    std::vector<WorkerEvents> workerEvents; // one per worker
+    // Batched detect() for Spheres, detectOrientedBoxSphere() and detectOrientedBoxesWithSat() respectively
+    void detectSpheresBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept;
+    void detectBoxesSpheresBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept;
+    void detectBoxesBatched(std::span<const ObjectIndexPair> pairs, Contacts& contacts) const noexcept;
+    std::vector<ObjectIndexPair> candidatePairs; // produced by the broadphase, unique
+    // Runs the narrowphase on each pair (split between helper threads if present)
+    void processPairs(std::span<const ObjectIndexPair> pairs) noexcept;
+    // ========================================================================
+    // ============== Heightfields
+    // ========================================================================
+    // Heightfields are left out of the broadphase: a single one would overlap
+    // every Body above it. Instead each awake Body is tested against the cells
+    // under its AABB, and the contacts join the narrowphase results.
+    std::vector<HeightGrid> heightGrids;
+    std::vector<uint32_t> heightfieldObjectIndices;
+    void detectHeightfieldContacts() noexcept;
+    // Return dir from the Heightfield towards the shape. The triangles (for
+    // the Sphere) and the corners (for the Box) are tested 8 at a time.
+    static std::optional<Detection> detectHeightfieldSphere(const HeightGrid& grid, const Object::Sphere& s) noexcept;
+    static std::optional<Detection> detectHeightfieldBox(const HeightGrid& grid, const Object::Box& b,
+        const Object::AABB& aabb, const Object::Box::OrientationData& axes, const hml::vec3_256& corners) noexcept;
+
+    // (smaller index, larger index) packed into a single integer, so that the
+    // same pair found twice produces the same key; of objectIndices or of Ids
+    using PairKey = uint64_t;
+    inline static PairKey packPair(uint32_t index1, uint32_t index2) noexcept {
+        const auto [min, max] = std::minmax(index1, index2);
+        return (static_cast<PairKey>(min) << 32) | static_cast<PairKey>(max);
+    }
+    inline static ObjectIndexPair unpackPair(PairKey key) noexcept {
+        return ObjectIndexPair{ static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key) };
+    }
+    std::vector<std::vector<PairKey>> threadPairKeys; // one per worker
+    std::vector<PairKey> pairKeys;
+    std::vector<PairKey> pairKeysScratch;
+    // Rows [beginPosition, endPosition) of bucketTable.objectIndices, the
+    // first of which is in bucketTable.usedSlots[usedSlotIndex]. A row stands
+    // for the pairs of an Object with the ones after it in the same Bucket, so
+    // even a single crowded Bucket gets split between several tasks, while a
+    // task may span many sparse Buckets (the rows without pairs included).
+    struct GridTask {
+        uint32_t usedSlotIndex;
+        uint32_t beginPosition;
+        uint32_t endPosition;
+    };
+    std::vector<GridTask> gridTasks;
+    // Sorts pairKeys with an LSD radix sort (split between helper threads if
+    // present), drops the duplicates and unpacks the rest into candidatePairs
+    void sortUniquePairKeys() noexcept;
+    // An Object spanning several Buckets meets its neighbors in more than one
+    // of them, so the pairs are deduplicated with sortUniquePairKeys()
+    void findGridPairs() noexcept;
+    // ========================================================================
+    // ============== Contact solver
+    // ========================================================================
+    // A separate stage after the narrowphase. Every contact point becomes a
+    // constraint with an accumulated impulse along the normal (never pulling)
+    // and two along the tangents (friction, bounded by FRICTION times the
+    // normal one). The velocity iterations sweep over all of them (sequential
+    // impulses), after which the position iterations push the bodies apart
+    // until only CONTACT_SLOP of the penetration is left.
+    // The impulses are remembered in contactCache, and a point of the next
+    // step close to an old one of the same pair starts from its impulses
+    // (warm starting), so resting contacts don't have to rebuild their
+    // support from nothing every step. The pairs are told apart by the Ids,
+    // which stay put when a removal moves the Objects around.
+    // The pairs are colored so that no two of the same color share a Body;
+    // the pairs of a color are then split between helper threads, while the
+    // colors themselves are solved one after another.
+    inline static constexpr float CONTACT_SLOP = 0.005f;
+    inline static constexpr float CONTACT_MATCH_DISTANCE = 0.05f;
+    inline static constexpr float RESTITUTION = 0.9f;
+    // Slower impacts don't bounce at all, which is what lets stacks rest
+    inline static constexpr float RESTITUTION_VELOCITY = 1.0f;
+    inline static constexpr float FRICTION = 0.5f;
+    // The fraction of the penetration removed by a single position iteration, and at most how much
+    inline static constexpr float POSITION_CORRECTION = 0.2f;
+    inline static constexpr float MAX_POSITION_CORRECTION = 0.2f;
+    // Pairs that don't get one of the first colors all go to the last one, solved by a single thread
+    inline static constexpr uint32_t COLOR_COUNT = 64;
+    inline static constexpr uint32_t OVERFLOW_COLOR = COLOR_COUNT - 1;
+
+    SolverSettings solverSettings; // set through the SetSolverIterations Command
+
+    // The state of a Body while solving. The one after all Bodies stands for
+    // every stationary Object: it has zero inverse mass and is never written to.
+    struct SolverBody {
+        glm::vec3 velocity;
+        glm::vec3 angularVelocity;
+        glm::vec3 angularMomentumDelta; // what gets added to the Body at the end
+        glm::vec3 positionDelta;
+        glm::vec3 rotationDelta; // small angle, around the axis
+        glm::mat3 invInertiaWorld;
+        float invMass;
+
+        // impulse is applied at r (from the center)
+        inline void applyImpulse(const glm::vec3& r, const glm::vec3& impulse) noexcept {
+            const auto angularImpulse = glm::cross(r, impulse);
+            velocity             += impulse * invMass;
+            angularVelocity      += invInertiaWorld * angularImpulse;
+            angularMomentumDelta += angularImpulse;
+        }
+        inline void applyPositionImpulse(const glm::vec3& r, const glm::vec3& impulse) noexcept {
+            positionDelta += impulse * invMass;
+            rotationDelta += invInertiaWorld * glm::cross(r, impulse);
+        }
+        inline glm::vec3 velocityAt(const glm::vec3& r) const noexcept { return velocity + glm::cross(angularVelocity, r); }
+        inline glm::vec3 displacementAt(const glm::vec3& r) const noexcept { return positionDelta + glm::cross(rotationDelta, r); }
+    };
+    inline Object::BodyIndex stationarySolverBody() const noexcept { return static_cast<Object::BodyIndex>(bodies.size()); }
+
+    // Ordered by color. The normal and the Bodies are shared by all points of a pair.
+    struct ContactConstraints {
+        // Per pair
+        std::vector<PairKey> keys; // of the Ids
+        std::vector<Object::BodyIndex> body1s, body2s; // into solverBodies
+        std::vector<glm::vec3> normals; // from body1 towards body2
+        std::vector<glm::vec3> tangent1s, tangent2s;
+        std::vector<float> separations; // negative while penetrating
+        std::vector<uint32_t> pointBegins; // the points of pair i are [pointBegins[i], pointBegins[i + 1])
+        // Per point
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec3> r1s, r2s; // from the centers of the Objects to the point
+        std::vector<float> normalMasses, tangent1Masses, tangent2Masses; // the effective masses
+        std::vector<float> biases; // separating velocity to reach (restitution)
+        std::vector<float> normalImpulses, tangent1Impulses, tangent2Impulses; // accumulated
+
+        std::array<uint32_t, COLOR_COUNT + 1> colorBegins; // into the per pair arrays
+
+        inline size_t size() const noexcept { return keys.size(); }
+        void resize(size_t pairCount, size_t pointCount) noexcept;
+    } contactConstraints;
+    struct CachedContact {
+        PairKey key;
+        glm::vec3 point;
+        float normalImpulse;
+        float tangent1Impulse;
+        float tangent2Impulse;
+    };
+    std::vector<SolverBody> solverBodies;
+    std::vector<uint64_t> solverBodyColors; // a bit for every color that already has a pair with the Body
+    // A pair among the workers' Contacts
+    struct ContactRef {
+        PairKey key; // of the objectIndices
+        uint32_t batch; // into narrowphaseBatches
+        uint32_t index; // into its Contacts
+    };
+    std::vector<ContactRef> contactOrder; // of the last narrowphase, sorted by key
+    std::vector<uint32_t> contactColors; // for each of contactOrder
+    std::vector<CachedContact> contactCache; // of the last step, sorted by key
+    // Turns the contacts of the last narrowphase into constraints, solves them
+    // and updates the Bodies and the contactCache
+    void solveContacts() noexcept;
+    void buildContactConstraints() noexcept;
+    // Calls func(pair) for every pair, one color at a time, split between helper threads
+    template<typename F>
+    void forEachContactPairByColor(const F& func) noexcept;
+    void warmStartContactPair(size_t pair) noexcept;
+    void solveContactPairVelocities(size_t pair) noexcept;
+    void solveContactPairPositions(size_t pair) noexcept;
+    const CachedContact* findCachedContact(PairKey key, const glm::vec3& point) const noexcept;
+    // ========================================================================
+    // ============== Sweep and prune
+    // ========================================================================
+    // Endpoints of all AABBs along a single (dominant) axis are kept sorted.
+    // Because objects move little between steps, re-sorting them with an
+    // insertion sort is close to linear. Objects whose intervals on that axis
+    // overlap are then tested on the other two axes 8 at a time.
+    struct SweepAndPrune {
+        struct Endpoint {
+            inline static constexpr uint32_t END_BIT = 1u << 31;
+            float value;
+            uint32_t objectIndexAndEnd; // objectIndex | (isEnd ? END_BIT : 0)
+        };
+        std::vector<Endpoint> endpoints;
+        std::vector<Object::AABB> aabbs; // for each Object (same indexing)
+        std::vector<bool> stationary;    // for each Object (same indexing)
+        int axis = 0;
+
+        // The currently overlapping intervals, projected onto the other two axes
+        Bodies::Array activeMinAs, activeMaxAs, activeMinBs, activeMaxBs;
+        Bodies::Array activeDynamicMasks; // all bits set for non-stationary objects
+        std::vector<uint32_t> activeObjectIndices;
+        std::vector<uint32_t> activeSlotOfObject; // for each Object (same indexing)
+
+        void insert(uint32_t objectIndex, const Object::AABB& aabb, bool isStationary) noexcept;
+        // Keeps the indexing for an Object that is left out (has no endpoints)
+        void skip(uint32_t objectIndex) noexcept;
+        // Moves the last Object into objectIndex; linear in the number of endpoints
+        void remove(uint32_t objectIndex) noexcept;
+        // Picks the dominant axis and re-sorts the endpoints for the updated aabbs
+        void update() noexcept;
+        void findPairs(std::vector<ObjectIndexPair>& pairs) noexcept;
+    } sweepAndPrune;
+    // ========================================================================
+    // ============== Dynamic AABB tree
+    // ========================================================================
+    // A binary tree over fat (enlarged) AABBs, kept balanced with rotations.
+    // A leaf is only reinserted once the Object's AABB leaves its fat one, so
+    // small moves cost a containment check. Being adaptive, the tree does not
+    // care how much the sizes of the Objects vary.
+    struct AabbTree {
+        using NodeIndex = uint32_t;
+        inline static constexpr NodeIndex NULL_NODE = std::numeric_limits<NodeIndex>::max();
+        // The fat AABB grows by this fraction of the largest extent of the Object...
+        inline static constexpr float FAT_MARGIN_RELATIVE = 0.1f;
+        // ...plus this much (so that tiny Objects also get some slack)
+        inline static constexpr float FAT_MARGIN_ABSOLUTE = 0.05f;
+        // ...and is stretched in the direction of motion by this many steps worth of displacement
+        inline static constexpr float DISPLACEMENT_MULTIPLIER = 4.0f;
+
+        struct Node {
+            Object::AABB aabb;            // fat for leaves of a tree of dynamic Objects
+            NodeIndex parent = NULL_NODE; // the next free Node while in the free list
+            NodeIndex left   = NULL_NODE;
+            NodeIndex right  = NULL_NODE;
+            int32_t height   = 0;         // 0 for leaves, -1 for free Nodes
+            uint32_t objectIndex = 0;     // for leaves
+
+            inline bool isLeaf() const noexcept { return left == NULL_NODE; }
+        };
+        std::vector<Node> nodes;
+        NodeIndex root = NULL_NODE;
+        NodeIndex freeList = NULL_NODE;
+        size_t leafCount = 0;
+
+        // The aabb is stored as is; fatten it beforehand for dynamic Objects
+        NodeIndex insert(uint32_t objectIndex, const Object::AABB& aabb) noexcept;
+        void remove(NodeIndex leaf) noexcept;
+        // Returns whether the leaf had to be reinserted (with a fresh fat AABB,
+        // which accounts for the expected displacement over the next step)
+        bool update(NodeIndex leaf, const Object::AABB& aabb, const glm::vec3& displacement) noexcept;
+        inline int32_t height() const noexcept { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+        static Object::AABB fatten(const Object::AABB& aabb, const glm::vec3& displacement = glm::vec3(0.0f)) noexcept;
+        static Object::AABB merged(const Object::AABB& aabb1, const Object::AABB& aabb2) noexcept;
+        static float surfaceArea(const Object::AABB& aabb) noexcept;
+        static bool contains(const Object::AABB& outer, const Object::AABB& inner) noexcept;
+
+        // Pairs of overlapping leaves within the subtree
+        void selfPairs(NodeIndex node, std::vector<ObjectIndexPair>& pairs) const noexcept;
+        // Pairs of overlapping leaves between the two subtrees
+        static void crossPairs(const AabbTree& tree1, NodeIndex node1,
+                               const AabbTree& tree2, NodeIndex node2,
+                               std::vector<ObjectIndexPair>& pairs) noexcept;
+
+        NodeIndex allocateNode() noexcept;
+        void freeNode(NodeIndex node) noexcept;
+        void insertLeaf(NodeIndex leaf) noexcept;
+        void removeLeaf(NodeIndex leaf) noexcept;
+        // Refits and rebalances all ancestors of the node (inclusive)
+        void refitFrom(NodeIndex node) noexcept;
+        // Performs a left or right rotation if the node is imbalanced; returns the new subtree root
+        NodeIndex balance(NodeIndex node) noexcept;
+    };
+    // Static and dynamic Objects live in separate trees: the static one never
+    // changes, and static-static pairs are never produced.
+    AabbTree staticTree, dynamicTree;
+    std::vector<AabbTree::NodeIndex> treeLeafOfObject; // for each Object (same indexing); in staticTree or dynamicTree
+    std::vector<std::vector<ObjectIndexPair>> threadCandidatePairs; // one per worker
+    // Fills candidatePairs with overlapping dynamic-dynamic and dynamic-static
+    // leaves, splitting the traversal between the helper threads if present.
+    void findTreePairs() noexcept;
     // ========================================================================
     // ============== Geometry helpers
     // ========================================================================
@@ -377,16 +1238,16 @@ class HmlPhysics {
         std::span<const glm::vec3> psFrom,
         std::span<const glm::vec3> psOnto,
         const Object::Box::OrientationData& orientationDataOnto,
-        std::vector<glm::vec3>& contactPoints) noexcept;
+        ContactManifold& contactPoints) noexcept;
     static void findContactPointsBoxesAvxCompact(
         std::span<const glm::vec3> psFrom,
         std::span<const glm::vec3> psOnto,
         const Object::Box::OrientationData& orientationDataOnto,
-        std::vector<glm::vec3>& contactPoints) noexcept;
+        ContactManifold& contactPoints) noexcept;
     static void findContactPointsBoxesAvxFastest(
         const std::array<glm::vec3, 2 * 8>& psPacked,
         const std::array<Object::Box::OrientationData, 2>& orientationDataPacked,
-        std::vector<glm::vec3>& contactPoints) noexcept;
+        ContactManifold& contactPoints) noexcept;
 
     static void edgeFaceIntersection6Comp(
         const hml::vec3_256& edgePointA,
@@ -412,21 +1273,60 @@ class HmlPhysics {
         float I_zs_ptr[8]) noexcept;
     // ========================================================================
     void internalRegisterObject(const Object& object) noexcept;
+    void internalRegisterHeightfield(Object& object, HeightGrid&& grid) noexcept;
+    void internalRemoveObject(uint32_t objectIndex) noexcept;
+    void removeBody(Object::BodyIndex bodyIndex) noexcept;
+    void removeHeightGrid(uint32_t gridIndex) noexcept;
+    void pushCommand(Command&& command) noexcept;
+    // Wakes up the physics thread if it is waiting for something to do
+    void notifyPendingCommands() noexcept;
+    void drainCommands() noexcept;
+    void executeCommand(Command& command) noexcept;
     void step(float dt) noexcept;
     // ========================================================================
     public:
-        HmlPhysics(Mode mode) noexcept;
+        // helperThreads is only used by Modes with helper threads, 0 to use std::thread::hardware_concurrency()
+        HmlPhysics(Mode mode, Broadphase broadphase = Broadphase::Grid, size_t helperThreads = PHYSICS_HELPER_THREADS) noexcept;
         ~HmlPhysics() noexcept;
         inline bool hasSelfThread()    const noexcept { return mode == Mode::AnotherThread              || mode == Mode::AnotherThreadAndHelperThreads; }
         inline bool hasHelperThreads() const noexcept { return mode == Mode::SameThreadAndHelperThreads || mode == Mode::AnotherThreadAndHelperThreads; }
         void updateForDt(float dt) noexcept;
         Object::Id registerObject(Object&& object) noexcept;
+        // Moves from objects; wakes up the physics thread only once for all of them
+        std::vector<Object::Id> registerObjects(std::span<Object> objects) noexcept;
+        // Static terrain, e.g. that of Himmel::World; grid must have at least 2x2 samples
+        Object::Id registerHeightfield(HeightGrid&& grid) noexcept;
+        // Any kind of Object; whatever was resting on it wakes up. The Id gets
+        // invalid, and the Commands that still come with it are ignored.
+        // With a self thread it takes effect at the start of the next step.
+        void removeObject(Object::Id id) noexcept;
         void printStats() const noexcept;
         std::optional<ThreadedStats> getThreadedStats() const noexcept;
-        std::vector<std::pair<Object::Id, glm::mat4>> getModelMatrices() noexcept;
+        // Of the last finished step; from any thread
+        inline StepStats getStepStats() const noexcept { return publishedStepStats.latest(); }
+        // The view stays valid until the next call. NOTE Only for a single reader.
+        std::span<const std::pair<Object::Id, glm::mat4>> getModelMatrices() noexcept;
         void terminate() noexcept;
         void threadFunc() noexcept;
         void setGravity(const glm::vec3& newGravity) noexcept;
+        // More iterations give stiffer stacks and less penetration for more time per step
+        void setSolverIterations(int velocityIterations, int positionIterations) noexcept;
+        // The cells of level L are finestCellSize * 2^L large; at most GridLevels::MAX_COUNT levels.
+        // The queries use the Bucket grid whichever the broadphase is.
+        void setGridLevels(float finestCellSize, size_t levelCount) noexcept;
+        // All of these are for non-stationary Objects only and wake them up.
+        // With a self thread they take effect at the start of the next step.
+        // Changes the velocity by impulse / mass
+        void applyImpulse(Object::Id id, const glm::vec3& impulse) noexcept;
+        void setVelocity(Object::Id id, const glm::vec3& velocity) noexcept;
+        void setTransform(Object::Id id, const glm::vec3& position, const glm::quat& orientation) noexcept;
+        // Safe to call from any number of threads; they see the world as of the end of the last step.
+        // hits must be at least as large as rays
+        void raycast(std::span<const Ray> rays, std::span<RayHit> hits) const noexcept;
+        // Appends an OverlapHit for every Object that each of the shapes (Spheres and Boxes) touches
+        void overlap(std::span<const Object> shapes, std::vector<OverlapHit>& hits) const noexcept;
+        // GJK+EPA on two Box Objects: (dir from box1 towards box2, extent). Exposed for the benchmark
+        static std::optional<std::pair<glm::vec3, float>> penetrationGjk(const Object& box1, const Object& box2) noexcept;
         // Object& getObject(Object::Id id) noexcept;
 };
 
@@ -18,6 +18,7 @@
 
 #define WITH_IMGUI 1
 #define WITH_PHYSICS 0
+#define PHYSICS_HELPER_THREADS 0 // 0 to use std::thread::hardware_concurrency()
 
 
 #endif